@@ -0,0 +1,247 @@
+// flockbench: time one flock step over a sweep of flock sizes, radii & robot modes
+//
+//   flockbench [options] > results.csv
+//     --2d, --3d           only this rule set (default both)
+//     --boids LIST         flock sizes (default 100,1000,10000,100000,1000000)
+//     --neighbor LIST      neighborDistance / neighborDist values
+//     --separation LIST    separationValue / separationVal values
+//     --modes LIST         3D robot modes: none, predator, leader (default all)
+//     --threads T          worker threads (default one per core)
+//     --multithreaded      double-buffered parallel update
+//     --simd [LEVEL]       vectorized rules, LEVEL = scalar | sse4 | avx2 (default best)
+//     --seed S             random seed for the initial flock (default 0)
+//     --min-time S         time each configuration for at least S seconds (default 0.5)
+//     --budget S           skip larger flocks once one step takes longer than S (default 5)
+//     --json               write a json array instead of csv
+//
+// LIST is comma separated, e.g. --boids 1000,5000 --neighbor 20,40
+// a step is neighbor rules + integrate + wrap, the same step() the apps call every frame
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Simulation2D.h"
+#include "Simulation3D.h"
+
+struct Options {
+	bool run2D = true, run3D = true;
+	std::vector<float> boids = { 100, 1000, 10000, 100000, 1000000 };
+	std::vector<float> neighbor, separation; // empty = per rule set defaults
+	std::vector<std::string> modes = { "none", "predator", "leader" };
+	int threads = std::thread::hardware_concurrency();
+	bool multithreaded = false;
+	bool simd = false;
+	kernels::Level level = kernels::detect();
+	unsigned seed = 0;
+	double minTime = 0.5;
+	double budget = 5;
+	bool json = false;
+};
+
+// one timed configuration
+struct Result {
+	const char* rules;
+	int boids;
+	float neighbor, separation;
+	std::string mode;
+	int steps;
+	double seconds;
+};
+
+static void usage() {
+	fprintf(stderr,
+		"usage: flockbench [--2d | --3d] [--boids LIST] [--neighbor LIST] [--separation LIST]\n"
+		"                  [--modes LIST] [--threads T] [--multithreaded] [--simd [scalar|sse4|avx2]]\n"
+		"                  [--seed S] [--min-time S] [--budget S] [--json]\n");
+	exit(1);
+}
+
+static std::vector<std::string> split(const std::string& list) {
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t end = list.find(',', start);
+		if (end == std::string::npos) end = list.size();
+		if (end > start) items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+
+static std::vector<float> numbers(const std::string& list) {
+	std::vector<float> values;
+	for (const std::string& item : split(list)) values.push_back(atof(item.c_str()));
+	if (values.empty()) usage();
+	return values;
+}
+
+static Options parse(int argc, char** argv) {
+	Options o;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--2d") { o.run2D = true; o.run3D = false; }
+		else if (arg == "--3d") { o.run2D = false; o.run3D = true; }
+		else if (arg == "--boids" && hasValue) o.boids = numbers(argv[++i]);
+		else if (arg == "--neighbor" && hasValue) o.neighbor = numbers(argv[++i]);
+		else if (arg == "--separation" && hasValue) o.separation = numbers(argv[++i]);
+		else if (arg == "--modes" && hasValue) {
+			o.modes = split(argv[++i]);
+			for (const std::string& m : o.modes) {
+				if (m != "none" && m != "predator" && m != "leader") usage();
+			}
+		}
+		else if (arg == "--threads" && hasValue) o.threads = atoi(argv[++i]);
+		else if (arg == "--multithreaded") o.multithreaded = true;
+		else if (arg == "--simd") {
+			o.simd = true;
+			if (hasValue && argv[i + 1][0] != '-') {
+				std::string level = argv[++i];
+				if (level == "scalar") o.level = kernels::Scalar;
+				else if (level == "sse4") o.level = kernels::SSE4;
+				else if (level == "avx2") o.level = kernels::AVX2;
+				else usage();
+			}
+		}
+		else if (arg == "--seed" && hasValue) o.seed = atoi(argv[++i]);
+		else if (arg == "--min-time" && hasValue) o.minTime = atof(argv[++i]);
+		else if (arg == "--budget" && hasValue) o.budget = atof(argv[++i]);
+		else if (arg == "--json") o.json = true;
+		else usage();
+	}
+
+	return o;
+}
+
+// step sim until minTime has passed, after one untimed warm up step
+// returns false if the warm up step alone went over budget
+template <typename Sim>
+static bool measure(Sim& sim, const Options& o, Result& r) {
+	const float dt = 1.0f / 60;
+	typedef std::chrono::steady_clock Clock;
+
+	auto start = Clock::now();
+	sim.step(dt);
+	double warmup = std::chrono::duration<double>(Clock::now() - start).count();
+	if (warmup > o.budget) return false;
+
+	r.steps = 0;
+	start = Clock::now();
+	do {
+		sim.step(dt);
+		r.steps++;
+		r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (r.seconds < o.minTime);
+
+	return true;
+}
+
+static void print(const Options& o, const Result& r, bool first) {
+	double stepsPerSec = r.steps / r.seconds;
+	double nsPerBoid = r.seconds * 1e9 / ((double)r.steps * std::max(r.boids, 1));
+	const char* simd = o.simd ? kernels::name(std::min(o.level, kernels::detect())) : "off";
+
+	if (o.json) {
+		printf("%s\n  {\"rules\": \"%s\", \"boids\": %d, \"neighbor\": %g, \"separation\": %g, "
+			"\"mode\": \"%s\", \"threads\": %d, \"multithreaded\": %s, \"simd\": \"%s\", "
+			"\"steps\": %d, \"seconds\": %.6f, \"steps_per_sec\": %.3f, \"ns_per_boid\": %.3f}",
+			first ? "" : ",", r.rules, r.boids, r.neighbor, r.separation, r.mode.c_str(),
+			o.threads, o.multithreaded ? "true" : "false", simd,
+			r.steps, r.seconds, stepsPerSec, nsPerBoid);
+	}
+	else {
+		printf("%s,%d,%g,%g,%s,%d,%d,%s,%d,%.6f,%.3f,%.3f\n",
+			r.rules, r.boids, r.neighbor, r.separation, r.mode.c_str(),
+			o.threads, o.multithreaded, simd,
+			r.steps, r.seconds, stepsPerSec, nsPerBoid);
+	}
+	fflush(stdout);
+}
+
+static void log(const Result& r, const char* note) {
+	fprintf(stderr, "%s boids=%d neighbor=%g separation=%g mode=%s: %s\n",
+		r.rules, r.boids, r.neighbor, r.separation, r.mode.c_str(), note);
+}
+
+int main(int argc, char** argv) {
+	Options o = parse(argc, argv);
+	bool first = true;
+
+	if (o.json) printf("[");
+	else printf("rules,boids,neighbor,separation,mode,threads,multithreaded,simd,steps,seconds,steps_per_sec,ns_per_boid\n");
+
+	if (o.run2D) {
+		std::vector<float> neighbor = o.neighbor.empty() ? std::vector<float>{ 20, 50 } : o.neighbor;
+		std::vector<float> separation = o.separation.empty() ? std::vector<float>{ 100, 250 } : o.separation;
+
+		for (float n : neighbor) {
+			for (float s : separation) {
+				for (float count : o.boids) {
+					Result r = { "2d", (int)count, n, s, "none", 0, 0 };
+
+					Simulation2D sim(o.threads, o.seed);
+					sim.simdLevel = o.level;
+					FlockParams2D& p = sim.params;
+					p.startSim = true;
+					p.multithreaded = o.multithreaded;
+					p.simd = o.simd;
+					p.neighborDistance = n;
+					p.separationValue = s;
+					sim.createFlock(r.boids);
+
+					// flocks are swept smallest first, bigger ones would only be slower
+					if (!measure(sim, o, r)) {
+						log(r, "over budget, skipping larger flocks");
+						break;
+					}
+					print(o, r, first);
+					first = false;
+				}
+			}
+		}
+	}
+
+	if (o.run3D) {
+		std::vector<float> neighbor = o.neighbor.empty() ? std::vector<float>{ 20, 40 } : o.neighbor;
+		std::vector<float> separation = o.separation.empty() ? std::vector<float>{ 5, 10 } : o.separation;
+
+		for (const std::string& mode : o.modes) {
+			for (float n : neighbor) {
+				for (float s : separation) {
+					for (float count : o.boids) {
+						Result r = { "3d", (int)count, n, s, mode, 0, 0 };
+
+						Simulation3D sim(o.threads, o.seed);
+						sim.simdLevel = o.level;
+						FlockParams3D& p = sim.params;
+						p.startSim = true;
+						p.multithreaded = o.multithreaded;
+						p.simd = o.simd;
+						p.predatorMode = mode == "predator";
+						p.leaderMode = mode == "leader";
+						p.neighborDist = n;
+						p.separationVal = s;
+						sim.createFlock(r.boids);
+
+						if (!measure(sim, o, r)) {
+							log(r, "over budget, skipping larger flocks");
+							break;
+						}
+						print(o, r, first);
+						first = false;
+					}
+				}
+			}
+		}
+	}
+
+	if (o.json) printf("\n]\n");
+
+	return 0;
+}
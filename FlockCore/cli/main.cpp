@@ -0,0 +1,263 @@
+// flockrun: step a flock without a window as fast as the cpu allows
+//
+//   flockrun [options]
+//     --3d                 use the 3D rules (default 2D)
+//     --boids N            flock size (default 1000)
+//     --frames M           steps to run (default 1000)
+//     --dt S               seconds per frame (default 1/60)
+//     --fixed S            step each frame in fixed S second substeps
+//     --threads T          worker threads (default one per core)
+//     --multithreaded      double-buffered parallel update
+//     --simd [LEVEL]       vectorized rules, LEVEL = scalar | sse4 | avx2 (default best)
+//     --seed S             random seed for the initial flock (default 0)
+//     --neighbor D         neighborDistance / neighborDist
+//     --separation D       separationValue / separationVal
+//     --knn K              topological rules, each boid follows its K nearest boids
+//     --lists SKIN         reuse per boid neighbor lists reaching SKIN past the rule radii
+//     --predator, --leader robot boid mode (3D)
+//     --predators N        agents chasing the flock (3D)
+//     --leaders N          agents the flock follows (3D)
+//     --unbounded          boids roam freely instead of wrapping around the world box (3D)
+//     --record FILE        write every frame to a flock recording
+//     --load FILE          start from a checkpoint instead of a random flock
+//     --save FILE          write a checkpoint after the last frame
+//     --profile FILE       time each phase of every frame into a csv, print averages at the end
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "Simulation2D.h"
+#include "Simulation3D.h"
+
+struct Options {
+	bool is3D = false;
+	int boids = 1000;
+	int frames = 1000;
+	float dt = 1.0f / 60;
+	float fixedDt = 0;
+	int threads = std::thread::hardware_concurrency();
+	bool multithreaded = false;
+	bool simd = false;
+	kernels::Level level = kernels::detect();
+	unsigned seed = 0;
+	float neighbor = -1;
+	float separation = -1;
+	int knn = 0;
+	float skin = -1;
+	bool predator = false;
+	bool leader = false;
+	int predators = 0, leaders = 0;
+	bool unbounded = false;
+	std::string record;
+	std::string load, save;
+	std::string profile;
+};
+
+static void usage() {
+	fprintf(stderr,
+		"usage: flockrun [--3d] [--boids N] [--frames M] [--dt S] [--fixed S] [--threads T]\n"
+		"                [--multithreaded] [--simd [scalar|sse4|avx2]] [--seed S]\n"
+		"                [--neighbor D] [--separation D] [--knn K] [--lists SKIN]\n"
+		"                [--predator | --leader] [--predators N] [--leaders N] [--unbounded]\n"
+		"                [--record FILE] [--load FILE] [--save FILE]\n"
+		"                [--profile FILE]\n");
+	exit(1);
+}
+
+static Options parse(int argc, char** argv) {
+	Options o;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--3d") o.is3D = true;
+		else if (arg == "--2d") o.is3D = false;
+		else if (arg == "--boids" && hasValue) o.boids = atoi(argv[++i]);
+		else if (arg == "--frames" && hasValue) o.frames = atoi(argv[++i]);
+		else if (arg == "--dt" && hasValue) o.dt = atof(argv[++i]);
+		else if (arg == "--fixed" && hasValue) o.fixedDt = atof(argv[++i]);
+		else if (arg == "--threads" && hasValue) o.threads = atoi(argv[++i]);
+		else if (arg == "--multithreaded") o.multithreaded = true;
+		else if (arg == "--simd") {
+			o.simd = true;
+			if (hasValue && argv[i + 1][0] != '-') {
+				std::string level = argv[++i];
+				if (level == "scalar") o.level = kernels::Scalar;
+				else if (level == "sse4") o.level = kernels::SSE4;
+				else if (level == "avx2") o.level = kernels::AVX2;
+				else usage();
+			}
+		}
+		else if (arg == "--seed" && hasValue) o.seed = atoi(argv[++i]);
+		else if (arg == "--neighbor" && hasValue) o.neighbor = atof(argv[++i]);
+		else if (arg == "--separation" && hasValue) o.separation = atof(argv[++i]);
+		else if (arg == "--knn" && hasValue) o.knn = atoi(argv[++i]);
+		else if (arg == "--lists" && hasValue) o.skin = atof(argv[++i]);
+		else if (arg == "--predator") o.predator = true;
+		else if (arg == "--leader") o.leader = true;
+		else if (arg == "--predators" && hasValue) o.predators = atoi(argv[++i]);
+		else if (arg == "--leaders" && hasValue) o.leaders = atoi(argv[++i]);
+		else if (arg == "--unbounded") o.unbounded = true;
+		else if (arg == "--record" && hasValue) o.record = argv[++i];
+		else if (arg == "--load" && hasValue) o.load = argv[++i];
+		else if (arg == "--save" && hasValue) o.save = argv[++i];
+		else if (arg == "--profile" && hasValue) o.profile = argv[++i];
+		else usage();
+	}
+
+	return o;
+}
+
+// run frames steps of sim, returns seconds taken
+template <typename Sim>
+static double run(Sim& sim, const Options& o) {
+	FlockRecorder recorder;
+	if (!o.record.empty() && !recorder.open(o.record, o.is3D ? 3 : 2, Sim::recordedFloats)) {
+		fprintf(stderr, "flockrun: can't write %s\n", o.record.c_str());
+		exit(1);
+	}
+
+	if (!o.profile.empty()) {
+		sim.profiler.enabled = true;
+		if (!sim.profiler.openCsv(o.profile)) {
+			fprintf(stderr, "flockrun: can't write %s\n", o.profile.c_str());
+			exit(1);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int f = 0; f < o.frames; f++) {
+		sim.update(o.dt);
+		if (recorder.isOpen()) sim.record(recorder);
+		sim.profiler.endFrame();
+	}
+
+	recorder.close();
+	sim.profiler.closeCsv();
+	if (sim.profiler.enabled) printf("%s", sim.profiler.report().c_str());
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// restore sim from the o.load checkpoint
+template <typename Sim>
+static void load(Sim& sim, Options& o) {
+	if (!sim.load(o.load)) {
+		fprintf(stderr, "flockrun: can't load %s checkpoint %s\n", o.is3D ? "3d" : "2d", o.load.c_str());
+		exit(1);
+	}
+	o.boids = sim.flock.size();
+}
+
+template <typename Sim>
+static void save(const Sim& sim, const Options& o) {
+	if (!sim.save(o.save)) {
+		fprintf(stderr, "flockrun: can't write %s\n", o.save.c_str());
+		exit(1);
+	}
+}
+
+// average boid position, to compare runs
+template <typename Flock>
+static glm::vec3 centroid(const Flock& flock) {
+	glm::vec3 sum = glm::vec3(0, 0, 0);
+	for (int i = 0; i < flock.size(); i++) sum += flock.position[i];
+	return flock.size() > 0 ? sum / (float)flock.size() : sum;
+}
+
+static void report(const Options& o, kernels::Level level, double seconds, glm::vec3 center) {
+	double steps = o.frames / seconds;
+	double nsPerBoid = seconds * 1e9 / ((double)o.frames * std::max(o.boids, 1));
+
+	printf("rules=%s boids=%d frames=%d threads=%d multithreaded=%d simd=%s knn=%d\n",
+		o.is3D ? "3d" : "2d", o.boids, o.frames, o.threads, o.multithreaded,
+		o.simd ? kernels::name(level) : "off", o.knn);
+	printf("seconds=%.3f steps/sec=%.1f ns/boid=%.1f centroid=%.4f,%.4f,%.4f\n",
+		seconds, steps, nsPerBoid, center.x, center.y, center.z);
+}
+
+// how often the neighbor lists were rebuilt, to tune --lists SKIN
+static void report(const NeighborList& lists) {
+	long long steps = lists.steps, rebuilds = lists.rebuilds;
+	printf("list steps=%lld rebuilds=%lld steps/rebuild=%.1f\n",
+		steps, rebuilds, rebuilds > 0 ? (double)steps / rebuilds : 0.0);
+}
+
+int main(int argc, char** argv) {
+	Options o = parse(argc, argv);
+
+	if (o.is3D) {
+		Simulation3D sim(o.threads, o.seed);
+		sim.simdLevel = o.level;
+
+		// a checkpoint brings its own params, the options below override them
+		if (!o.load.empty()) load(sim, o);
+
+		FlockParams3D& p = sim.params;
+		p.startSim = true;
+		p.multithreaded = o.multithreaded;
+		p.simd = o.simd;
+		p.fixedTimestep = o.fixedDt > 0;
+		if (o.fixedDt > 0) p.fixedDt = o.fixedDt;
+		if (o.load.empty() || o.predator || o.leader) {
+			p.predatorMode = o.predator;
+			p.leaderMode = o.leader && !o.predator;
+		}
+		if (o.predators > 0) p.numPredators = o.predators;
+		if (o.leaders > 0) p.numLeaders = o.leaders;
+		if (o.unbounded) p.unbounded = true;
+		if (o.neighbor > 0) p.neighborDist = o.neighbor;
+		if (o.separation > 0) p.separationVal = o.separation;
+		if (o.knn > 0) {
+			p.topological = true;
+			p.numNearest = o.knn;
+		}
+		if (o.skin >= 0) {
+			p.neighborLists = true;
+			p.skin = o.skin;
+		}
+
+		if (o.load.empty()) sim.createFlock(o.boids);
+		double seconds = run(sim, o);
+		report(o, std::min(sim.simdLevel, kernels::detect()), seconds, centroid(sim.flock));
+		if (o.skin >= 0) report(sim.neighborList);
+		if (!o.save.empty()) save(sim, o);
+	}
+	else {
+		Simulation2D sim(o.threads, o.seed);
+		sim.simdLevel = o.level;
+
+		// a checkpoint brings its own params, the options below override them
+		if (!o.load.empty()) load(sim, o);
+
+		FlockParams2D& p = sim.params;
+		p.startSim = true;
+		p.multithreaded = o.multithreaded;
+		p.simd = o.simd;
+		p.fixedTimestep = o.fixedDt > 0;
+		if (o.fixedDt > 0) p.fixedDt = o.fixedDt;
+		if (o.neighbor > 0) p.neighborDistance = o.neighbor;
+		if (o.separation > 0) p.separationValue = o.separation;
+		if (o.knn > 0) {
+			p.topological = true;
+			p.numNearest = o.knn;
+		}
+		if (o.skin >= 0) {
+			p.neighborLists = true;
+			p.skin = o.skin;
+		}
+
+		if (o.load.empty()) sim.createFlock(o.boids);
+		double seconds = run(sim, o);
+		report(o, std::min(sim.simdLevel, kernels::detect()), seconds, centroid(sim.flock));
+		if (o.skin >= 0) report(sim.neighborList);
+		if (!o.save.empty()) save(sim, o);
+	}
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+// stable ids for boids kept densely packed in arrays
+// a boid's index changes when another boid is swap-removed, its id doesn't
+// ids of removed boids are reused, so nothing grows past the largest flock
+class BoidIds {
+public:
+	// new id for the boid added at index
+	int add(int index) {
+		int id;
+		if (!freeIds.empty()) {
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else {
+			id = slot.size();
+			slot.push_back(-1);
+		}
+
+		slot[id] = index;
+		ids.push_back(id);
+		return id;
+	}
+
+	// boid at index removed, the last boid moves into its place
+	void remove(int index) {
+		slot[ids[index]] = -1;
+		freeIds.push_back(ids[index]);
+
+		ids[index] = ids.back();
+		ids.pop_back();
+		if (index < (int)ids.size()) slot[ids[index]] = index;
+	}
+
+	void clear() {
+		ids.clear();
+		slot.clear();
+		freeIds.clear();
+	}
+
+	void reserve(int n) {
+		ids.reserve(n);
+		slot.reserve(n);
+		freeIds.reserve(n);
+	}
+
+	int id(int index) const { return ids[index]; }
+
+	// index of boid id, -1 once it's removed
+	int index(int id) const { return id >= 0 && id < (int)slot.size() ? slot[id] : -1; }
+
+private:
+	std::vector<int> ids; // per index
+	std::vector<int> slot; // index per id, -1 when free
+	std::vector<int> freeIds;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+
+// simulation checkpoints: a CheckpointHeader followed by the raw bytes of every saved value & array
+// in the order they were put, the whole file is mapped back & read from memory
+
+struct CheckpointHeader {
+	char magic[4]; // "FLKC"
+	uint32_t version;
+	uint32_t dims;       // 2 or 3, which simulation wrote it
+	uint32_t paramsSize; // sizeof the params struct, guards against params changing between builds
+	uint32_t numBoids;
+};
+
+static const uint32_t checkpointVersion = 1;
+
+
+// collects a checkpoint in memory, written out in one go
+class CheckpointWriter {
+public:
+	CheckpointWriter(const CheckpointHeader& header) { put(header); }
+
+	template <typename T>
+	void put(const T& v) {
+		static_assert(std::is_trivially_copyable<T>::value, "checkpoints hold plain values only");
+		const char* p = (const char*)&v;
+		data.insert(data.end(), p, p + sizeof(T));
+	}
+
+	template <typename T>
+	void put(const std::vector<T>& a) {
+		static_assert(std::is_trivially_copyable<T>::value, "checkpoints hold plain values only");
+		const char* p = (const char*)a.data();
+		data.insert(data.end(), p, p + sizeof(T) * a.size());
+	}
+
+	bool save(const std::string& path) const {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) return false;
+		bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && ok;
+	}
+
+private:
+	std::vector<char> data;
+};
+
+
+// a whole checkpoint file, values are taken out in the order they were put
+// the file is mapped, so its size comes from the OS in full rather than from a 32 bit ftell
+class CheckpointReader {
+public:
+	// map path & check its header, dims & params size must match the loading simulation
+	bool load(const std::string& path, uint32_t dims, uint32_t paramsSize) {
+		at = 0;
+		if (!file.open(path)) return false;
+
+		return get(header) && memcmp(header.magic, "FLKC", 4) == 0 && header.version == checkpointVersion &&
+			header.dims == dims && header.paramsSize == paramsSize;
+	}
+
+	template <typename T>
+	bool get(T& v) {
+		if (sizeof(T) > remaining()) return false;
+		memcpy(&v, file.data() + at, sizeof(T));
+		at += sizeof(T);
+		return true;
+	}
+
+	// n entries into a, resizing it only once the file is known to hold them
+	template <typename T>
+	bool get(std::vector<T>& a, size_t n) {
+		if (n > remaining() / sizeof(T)) return false;
+		a.resize(n);
+		memcpy(a.data(), file.data() + at, sizeof(T) * n);
+		at += sizeof(T) * n;
+		return true;
+	}
+
+	// bytes left to take out
+	size_t remaining() const { return file.size() - at; }
+
+	CheckpointHeader header;
+
+private:
+	MappedFile file;
+	size_t at = 0;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// fixed size queue from one producer thread to one consumer thread, without locks
+// holds up to capacity - 1 entries, capacity must be a power of two
+template <typename T, size_t capacity = 256>
+class CommandQueue {
+	static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	// producer: add v, false if the queue is full
+	bool push(T v) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t next = (t + 1) & (capacity - 1);
+		if (next == head.load(std::memory_order_acquire)) return false;
+
+		slots[t] = std::move(v);
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// consumer: take the oldest entry into v, false if the queue is empty
+	bool pop(T& v) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+
+		v = std::move(slots[h]);
+		slots[h] = T(); // let go of anything the entry holds
+		head.store((h + 1) & (capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, capacity> slots;
+
+	// on their own cache lines, each is written by one side only
+	alignas(64) std::atomic<size_t> head{ 0 }; // next to pop
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next to push
+};
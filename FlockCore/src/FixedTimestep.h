@@ -0,0 +1,28 @@
+#pragma once
+
+// turns variable frame times into a whole number of constant dt steps
+// time left over carries to the next frame, at most maxSubsteps are taken per frame
+// so a slow frame drops time instead of making the next frame slower still
+struct FixedTimestep {
+	float dt = 1.0f / 60;
+	int maxSubsteps = 4;
+	float accumulator = 0;
+
+	// add frameTime seconds, returns the number of dt steps to take now
+	int advance(float frameTime) {
+		if (frameTime > 0) accumulator += frameTime;
+
+		int n = 0;
+		while (accumulator >= dt && n < maxSubsteps) {
+			accumulator -= dt;
+			n++;
+		}
+
+		// over the cap, drop the backlog
+		if (n == maxSubsteps && accumulator >= dt) accumulator = 0;
+
+		return n;
+	}
+
+	void reset() { accumulator = 0; }
+};
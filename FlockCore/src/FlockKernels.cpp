@@ -0,0 +1,287 @@
+#include "FlockKernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FLOCK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FLOCK_TARGET(x)
+#else
+#define FLOCK_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+namespace kernels {
+
+//--------------------------------------------------------------
+static void accumulateScalar(const NeighborQuery& q, const FlockLanes& l, int begin, int end, NeighborSums& s) {
+	glm::vec3 half = q.wrap / 2.0f;
+
+	for (int k = begin; k < end; k++) {
+		if (k == q.skip) continue;
+
+		glm::vec3 d = glm::vec3(l.x[k], l.y[k], l.z[k]) - q.position;
+		for (int a = 0; a < 3; a++) {
+			if (q.wrap[a] <= 0) continue;
+			if (d[a] > half[a]) d[a] -= q.wrap[a];
+			else if (d[a] < -half[a]) d[a] += q.wrap[a];
+		}
+		float d2 = glm::dot(d, d);
+
+		if ((d2 > q.sepMin2) && (d2 < q.sepMax2)) {
+			s.separation -= d / d2;
+			s.numSeparation++;
+		}
+
+		if ((d2 > q.cohMin2) && (d2 < q.cohMax2)) {
+			s.cohesion += d;
+			s.numCohesion++;
+		}
+
+		if ((d2 > q.aliMin2) && (d2 < q.aliMax2)) {
+			s.heading += glm::vec3(l.hx[k], l.hy[k], l.hz[k]);
+			s.speed = l.speed[k];
+			s.numAlignment++;
+		}
+	}
+}
+
+#ifdef FLOCK_X86
+
+//--------------------------------------------------------------
+FLOCK_TARGET("sse4.1")
+static float sum4(__m128 v) {
+	__m128 h = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+	return _mm_cvtss_f32(h);
+}
+
+// shortest offset per lane when wrapping around size, size 0 leaves d unchanged
+FLOCK_TARGET("sse4.1")
+static __m128 wrap4(__m128 d, __m128 size, __m128 half) {
+	__m128 over = _mm_and_ps(_mm_cmpgt_ps(d, half), size);
+	__m128 under = _mm_and_ps(_mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), half)), size);
+	return _mm_add_ps(_mm_sub_ps(d, over), under);
+}
+
+FLOCK_TARGET("sse4.1")
+static void accumulateSSE4(const NeighborQuery& q, const FlockLanes& l, int begin, int end, NeighborSums& s) {
+	const __m128 px = _mm_set1_ps(q.position.x), py = _mm_set1_ps(q.position.y), pz = _mm_set1_ps(q.position.z);
+	const __m128 wx = _mm_set1_ps(q.wrap.x), wy = _mm_set1_ps(q.wrap.y), wz = _mm_set1_ps(q.wrap.z);
+	const __m128 hwx = _mm_set1_ps(q.wrap.x / 2), hwy = _mm_set1_ps(q.wrap.y / 2), hwz = _mm_set1_ps(q.wrap.z / 2);
+	const __m128 sepMin = _mm_set1_ps(q.sepMin2), sepMax = _mm_set1_ps(q.sepMax2);
+	const __m128 cohMin = _mm_set1_ps(q.cohMin2), cohMax = _mm_set1_ps(q.cohMax2);
+	const __m128 aliMin = _mm_set1_ps(q.aliMin2), aliMax = _mm_set1_ps(q.aliMax2);
+	const __m128 one = _mm_set1_ps(1), skip = _mm_set1_ps((float)q.skip), step = _mm_set1_ps(4);
+
+	__m128 sepX = _mm_setzero_ps(), sepY = sepX, sepZ = sepX, sepN = sepX;
+	__m128 cohX = sepX, cohY = sepX, cohZ = sepX, cohN = sepX;
+	__m128 aliX = sepX, aliY = sepX, aliZ = sepX, aliN = sepX;
+	__m128 lastSpeed = sepX, lastLane = _mm_set1_ps(-1);
+	__m128 lane = _mm_add_ps(_mm_set1_ps((float)begin), _mm_setr_ps(0, 1, 2, 3));
+
+	int k = begin;
+	for (; k + 4 <= end; k += 4, lane = _mm_add_ps(lane, step)) {
+		__m128 dx = wrap4(_mm_sub_ps(_mm_loadu_ps(&l.x[k]), px), wx, hwx);
+		__m128 dy = wrap4(_mm_sub_ps(_mm_loadu_ps(&l.y[k]), py), wy, hwy);
+		__m128 dz = wrap4(_mm_sub_ps(_mm_loadu_ps(&l.z[k]), pz), wz, hwz);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 valid = _mm_cmpneq_ps(lane, skip);
+
+		// separation: (boid - neighbor) / dist^2
+		__m128 m = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(d2, sepMin), _mm_cmplt_ps(d2, sepMax)));
+		if (_mm_movemask_ps(m)) {
+			__m128 inv = _mm_div_ps(one, d2);
+			sepX = _mm_sub_ps(sepX, _mm_and_ps(m, _mm_mul_ps(dx, inv)));
+			sepY = _mm_sub_ps(sepY, _mm_and_ps(m, _mm_mul_ps(dy, inv)));
+			sepZ = _mm_sub_ps(sepZ, _mm_and_ps(m, _mm_mul_ps(dz, inv)));
+			sepN = _mm_add_ps(sepN, _mm_and_ps(m, one));
+		}
+
+		// cohesion: offsets to neighbors
+		m = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(d2, cohMin), _mm_cmplt_ps(d2, cohMax)));
+		cohX = _mm_add_ps(cohX, _mm_and_ps(m, dx));
+		cohY = _mm_add_ps(cohY, _mm_and_ps(m, dy));
+		cohZ = _mm_add_ps(cohZ, _mm_and_ps(m, dz));
+		cohN = _mm_add_ps(cohN, _mm_and_ps(m, one));
+
+		// alignment: neighbor headings, keep the speed of the latest neighbor per lane
+		m = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(d2, aliMin), _mm_cmplt_ps(d2, aliMax)));
+		aliX = _mm_add_ps(aliX, _mm_and_ps(m, _mm_loadu_ps(&l.hx[k])));
+		aliY = _mm_add_ps(aliY, _mm_and_ps(m, _mm_loadu_ps(&l.hy[k])));
+		aliZ = _mm_add_ps(aliZ, _mm_and_ps(m, _mm_loadu_ps(&l.hz[k])));
+		aliN = _mm_add_ps(aliN, _mm_and_ps(m, one));
+		lastSpeed = _mm_blendv_ps(lastSpeed, _mm_loadu_ps(&l.speed[k]), m);
+		lastLane = _mm_blendv_ps(lastLane, lane, m);
+	}
+
+	s.separation += glm::vec3(sum4(sepX), sum4(sepY), sum4(sepZ));
+	s.numSeparation += sum4(sepN);
+	s.cohesion += glm::vec3(sum4(cohX), sum4(cohY), sum4(cohZ));
+	s.numCohesion += sum4(cohN);
+	s.heading += glm::vec3(sum4(aliX), sum4(aliY), sum4(aliZ));
+	s.numAlignment += sum4(aliN);
+
+	alignas(16) float speeds[4], lanes[4];
+	_mm_store_ps(speeds, lastSpeed);
+	_mm_store_ps(lanes, lastLane);
+	float latest = -1;
+	for (int i = 0; i < 4; i++) {
+		if (lanes[i] > latest) {
+			latest = lanes[i];
+			s.speed = speeds[i];
+		}
+	}
+
+	// leftover lanes
+	accumulateScalar(q, l, k, end, s);
+}
+
+//--------------------------------------------------------------
+FLOCK_TARGET("avx2,fma")
+static float sum8(__m256 v) {
+	__m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+	h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+	return _mm_cvtss_f32(h);
+}
+
+FLOCK_TARGET("avx2,fma")
+static __m256 wrap8(__m256 d, __m256 size, __m256 half) {
+	__m256 over = _mm256_and_ps(_mm256_cmp_ps(d, half, _CMP_GT_OQ), size);
+	__m256 under = _mm256_and_ps(_mm256_cmp_ps(d, _mm256_sub_ps(_mm256_setzero_ps(), half), _CMP_LT_OQ), size);
+	return _mm256_add_ps(_mm256_sub_ps(d, over), under);
+}
+
+FLOCK_TARGET("avx2,fma")
+static __m256 inRange8(__m256 d2, __m256 min2, __m256 max2) {
+	return _mm256_and_ps(_mm256_cmp_ps(d2, min2, _CMP_GT_OQ), _mm256_cmp_ps(d2, max2, _CMP_LT_OQ));
+}
+
+FLOCK_TARGET("avx2,fma")
+static void accumulateAVX2(const NeighborQuery& q, const FlockLanes& l, int begin, int end, NeighborSums& s) {
+	const __m256 px = _mm256_set1_ps(q.position.x), py = _mm256_set1_ps(q.position.y), pz = _mm256_set1_ps(q.position.z);
+	const __m256 wx = _mm256_set1_ps(q.wrap.x), wy = _mm256_set1_ps(q.wrap.y), wz = _mm256_set1_ps(q.wrap.z);
+	const __m256 hwx = _mm256_set1_ps(q.wrap.x / 2), hwy = _mm256_set1_ps(q.wrap.y / 2), hwz = _mm256_set1_ps(q.wrap.z / 2);
+	const __m256 sepMin = _mm256_set1_ps(q.sepMin2), sepMax = _mm256_set1_ps(q.sepMax2);
+	const __m256 cohMin = _mm256_set1_ps(q.cohMin2), cohMax = _mm256_set1_ps(q.cohMax2);
+	const __m256 aliMin = _mm256_set1_ps(q.aliMin2), aliMax = _mm256_set1_ps(q.aliMax2);
+	const __m256 one = _mm256_set1_ps(1), skip = _mm256_set1_ps((float)q.skip), step = _mm256_set1_ps(8);
+
+	__m256 sepX = _mm256_setzero_ps(), sepY = sepX, sepZ = sepX, sepN = sepX;
+	__m256 cohX = sepX, cohY = sepX, cohZ = sepX, cohN = sepX;
+	__m256 aliX = sepX, aliY = sepX, aliZ = sepX, aliN = sepX;
+	__m256 lastSpeed = sepX, lastLane = _mm256_set1_ps(-1);
+	__m256 lane = _mm256_add_ps(_mm256_set1_ps((float)begin), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+
+	int k = begin;
+	for (; k + 8 <= end; k += 8, lane = _mm256_add_ps(lane, step)) {
+		__m256 dx = wrap8(_mm256_sub_ps(_mm256_loadu_ps(&l.x[k]), px), wx, hwx);
+		__m256 dy = wrap8(_mm256_sub_ps(_mm256_loadu_ps(&l.y[k]), py), wy, hwy);
+		__m256 dz = wrap8(_mm256_sub_ps(_mm256_loadu_ps(&l.z[k]), pz), wz, hwz);
+		__m256 d2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+		__m256 valid = _mm256_cmp_ps(lane, skip, _CMP_NEQ_OQ);
+
+		// separation: (boid - neighbor) / dist^2
+		__m256 m = _mm256_and_ps(valid, inRange8(d2, sepMin, sepMax));
+		if (_mm256_movemask_ps(m)) {
+			__m256 inv = _mm256_div_ps(one, d2);
+			sepX = _mm256_sub_ps(sepX, _mm256_and_ps(m, _mm256_mul_ps(dx, inv)));
+			sepY = _mm256_sub_ps(sepY, _mm256_and_ps(m, _mm256_mul_ps(dy, inv)));
+			sepZ = _mm256_sub_ps(sepZ, _mm256_and_ps(m, _mm256_mul_ps(dz, inv)));
+			sepN = _mm256_add_ps(sepN, _mm256_and_ps(m, one));
+		}
+
+		// cohesion: offsets to neighbors
+		m = _mm256_and_ps(valid, inRange8(d2, cohMin, cohMax));
+		cohX = _mm256_add_ps(cohX, _mm256_and_ps(m, dx));
+		cohY = _mm256_add_ps(cohY, _mm256_and_ps(m, dy));
+		cohZ = _mm256_add_ps(cohZ, _mm256_and_ps(m, dz));
+		cohN = _mm256_add_ps(cohN, _mm256_and_ps(m, one));
+
+		// alignment: neighbor headings, keep the speed of the latest neighbor per lane
+		m = _mm256_and_ps(valid, inRange8(d2, aliMin, aliMax));
+		aliX = _mm256_add_ps(aliX, _mm256_and_ps(m, _mm256_loadu_ps(&l.hx[k])));
+		aliY = _mm256_add_ps(aliY, _mm256_and_ps(m, _mm256_loadu_ps(&l.hy[k])));
+		aliZ = _mm256_add_ps(aliZ, _mm256_and_ps(m, _mm256_loadu_ps(&l.hz[k])));
+		aliN = _mm256_add_ps(aliN, _mm256_and_ps(m, one));
+		lastSpeed = _mm256_blendv_ps(lastSpeed, _mm256_loadu_ps(&l.speed[k]), m);
+		lastLane = _mm256_blendv_ps(lastLane, lane, m);
+	}
+
+	s.separation += glm::vec3(sum8(sepX), sum8(sepY), sum8(sepZ));
+	s.numSeparation += sum8(sepN);
+	s.cohesion += glm::vec3(sum8(cohX), sum8(cohY), sum8(cohZ));
+	s.numCohesion += sum8(cohN);
+	s.heading += glm::vec3(sum8(aliX), sum8(aliY), sum8(aliZ));
+	s.numAlignment += sum8(aliN);
+
+	alignas(32) float speeds[8], lanes[8];
+	_mm256_store_ps(speeds, lastSpeed);
+	_mm256_store_ps(lanes, lastLane);
+	float latest = -1;
+	for (int i = 0; i < 8; i++) {
+		if (lanes[i] > latest) {
+			latest = lanes[i];
+			s.speed = speeds[i];
+		}
+	}
+
+	// leftover lanes
+	accumulateScalar(q, l, k, end, s);
+}
+
+#endif
+
+//--------------------------------------------------------------
+Level detect() {
+#ifdef FLOCK_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx && avx2 && fma) return AVX2;
+	if (sse41) return SSE4;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return AVX2;
+	if (__builtin_cpu_supports("sse4.1")) return SSE4;
+#endif
+#endif
+	return Scalar;
+}
+
+const char* name(Level level) {
+	switch (level) {
+	case AVX2: return "AVX2";
+	case SSE4: return "SSE4";
+	default: return "Scalar";
+	}
+}
+
+void accumulate(Level level, const NeighborQuery& q, const FlockLanes& lanes,
+	int begin, int end, NeighborSums& sums) {
+	static const Level supported = detect();
+	level = std::min(level, supported);
+
+#ifdef FLOCK_X86
+	if (level == AVX2) return accumulateAVX2(q, lanes, begin, end, sums);
+	if (level == SSE4) return accumulateSSE4(q, lanes, begin, end, sums);
+#endif
+	accumulateScalar(q, lanes, begin, end, sums);
+}
+
+}
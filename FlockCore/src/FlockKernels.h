@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// neighbor positions, headings & speeds laid out one array per component
+// so the kernels can load 4 or 8 neighbors at a time
+struct FlockLanes {
+	void resize(int n) {
+		x.resize(n);
+		y.resize(n);
+		z.resize(n);
+		hx.resize(n);
+		hy.resize(n);
+		hz.resize(n);
+		speed.resize(n);
+	}
+
+	void set(int k, glm::vec3 p, glm::vec3 h, float s) {
+		x[k] = p.x;
+		y[k] = p.y;
+		z[k] = p.z;
+		hx[k] = h.x;
+		hy[k] = h.y;
+		hz[k] = h.z;
+		speed[k] = s;
+	}
+
+	int size() const { return x.size(); }
+
+	std::vector<float> x, y, z;
+	std::vector<float> hx, hy, hz;
+	std::vector<float> speed;
+};
+
+// which neighbors count for which rule, as open ranges of squared distance
+// a rule counts a neighbor when min2 < dist^2 < max2, max2 < 0 disables it
+struct NeighborQuery {
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	int skip = -1; // lane of the boid itself, -1 if not in the lanes
+
+	float sepMin2 = 0, sepMax2 = -1;
+	float cohMin2 = 0, cohMax2 = -1;
+	float aliMin2 = 0, aliMax2 = -1;
+
+	glm::vec3 wrap = glm::vec3(0, 0, 0); // world size to wrap offsets around, 0 = no wrap
+};
+
+// rule sums for one boid
+struct NeighborSums {
+	glm::vec3 separation = glm::vec3(0, 0, 0); // sum of (boid - neighbor) / dist^2
+	float numSeparation = 0;
+
+	glm::vec3 cohesion = glm::vec3(0, 0, 0); // sum of offsets from boid to neighbors
+	float numCohesion = 0;
+
+	glm::vec3 heading = glm::vec3(0, 0, 0); // sum of neighbor headings
+	float speed = 0; // speed of the last counted neighbor
+	float numAlignment = 0;
+};
+
+namespace kernels {
+	enum Level { Scalar, SSE4, AVX2 };
+
+	// best level the cpu supports
+	Level detect();
+	const char* name(Level level);
+
+	// add lanes [begin, end) to sums, falls back to a lower level if the cpu can't run level
+	void accumulate(Level level, const NeighborQuery& q, const FlockLanes& lanes,
+		int begin, int end, NeighborSums& sums);
+}
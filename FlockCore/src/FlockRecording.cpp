@@ -0,0 +1,162 @@
+#include "FlockRecording.h"
+
+#include <cstring>
+
+static const uint32_t recordingVersion = 1;
+
+// frames queued beyond this are dropped instead of growing memory while the disk catches up
+static const size_t maxQueued = 64;
+
+//--------------------------------------------------------------
+bool FlockRecorder::open(const std::string& path, int dims, int perBoid) {
+	close();
+
+	file = fopen(path.c_str(), "wb");
+	if (!file) return false;
+
+	RecordingHeader header = {};
+	memcpy(header.magic, "FLKR", 4);
+	header.version = recordingVersion;
+	header.dims = dims;
+	header.floatsPerBoid = perBoid;
+	fwrite(&header, sizeof(header), 1, file);
+	written = sizeof(header);
+
+	floatsPerBoid = perBoid;
+	offsets.clear();
+	dropped = 0;
+	closing = false;
+	writer = std::thread(&FlockRecorder::writeLoop, this);
+	return true;
+}
+
+void FlockRecorder::close() {
+	if (!file) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+	// frame index & footer
+	RecordingFooter footer = {};
+	memcpy(footer.magic, "FLKI", 4);
+	footer.numFrames = offsets.size();
+	footer.indexOffset = written;
+	fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file);
+	fwrite(&footer, sizeof(footer), 1, file);
+
+	fclose(file);
+	file = nullptr;
+	queue.clear();
+	pool.clear();
+}
+
+//--------------------------------------------------------------
+float* FlockRecorder::begin(const RecordedFrame& frame) {
+	// reuse a written buffer if there is one
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!pool.empty()) {
+			current.swap(pool.front());
+			pool.pop_front();
+		}
+	}
+
+	current.resize(sizeof(RecordedFrame) + sizeof(float) * frame.numBoids * floatsPerBoid);
+	memcpy(current.data(), &frame, sizeof(frame));
+	return (float*)(current.data() + sizeof(RecordedFrame));
+}
+
+void FlockRecorder::submit() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.size() >= maxQueued) {
+			dropped++;
+			return;
+		}
+		queue.push_back(std::vector<char>());
+		queue.back().swap(current);
+	}
+	wake.notify_one();
+}
+
+void FlockRecorder::writeLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		wake.wait(lock, [this]() { return closing || !queue.empty(); });
+		if (queue.empty()) return; // closing & everything written
+
+		std::vector<char> buffer;
+		buffer.swap(queue.front());
+		queue.pop_front();
+
+		// write without holding the lock, so submit never waits on the disk
+		lock.unlock();
+		offsets.push_back(written);
+		fwrite(buffer.data(), 1, buffer.size(), file);
+		written += buffer.size();
+		lock.lock();
+
+		pool.push_back(std::vector<char>());
+		pool.back().swap(buffer);
+	}
+}
+
+//--------------------------------------------------------------
+bool FlockRecording::open(const std::string& path) {
+	close();
+	if (!file.open(path)) return false;
+
+	const char* data = file.data();
+	size_t size = file.size();
+
+	header = (const RecordingHeader*)data;
+	if (size < sizeof(RecordingHeader) || memcmp(header->magic, "FLKR", 4) != 0 ||
+		header->version != recordingVersion) {
+		close();
+		return false;
+	}
+
+	// size of the frame at offset, 0 unless it lies whole within [header, end)
+	auto frameSize = [&](uint64_t offset, uint64_t end) -> uint64_t {
+		if (offset < sizeof(RecordingHeader) || offset > end || end - offset < sizeof(RecordedFrame)) return 0;
+		const RecordedFrame* frame = (const RecordedFrame*)(data + offset);
+		uint64_t bytes = sizeof(RecordedFrame) + sizeof(float) * (uint64_t)frame->numBoids * header->floatsPerBoid;
+		return bytes <= end - offset ? bytes : 0;
+	};
+
+	// frame index from the footer, used only if it & every frame it points at are within the file
+	if (size >= sizeof(RecordingHeader) + sizeof(RecordingFooter)) {
+		const RecordingFooter* footer = (const RecordingFooter*)(data + size - sizeof(RecordingFooter));
+		uint64_t indexEnd = size - sizeof(RecordingFooter);
+		if (memcmp(footer->magic, "FLKI", 4) == 0 && footer->indexOffset <= indexEnd &&
+			(indexEnd - footer->indexOffset) == footer->numFrames * sizeof(uint64_t)) {
+			const uint64_t* index = (const uint64_t*)(data + footer->indexOffset);
+			offsets.assign(index, index + footer->numFrames);
+
+			bool valid = true;
+			for (uint64_t offset : offsets) valid = valid && frameSize(offset, footer->indexOffset) > 0;
+			if (valid) return true;
+			offsets.clear();
+		}
+	}
+
+	// no index, the recording was cut short, walk the frames instead
+	uint64_t offset = sizeof(RecordingHeader);
+	while (uint64_t bytes = frameSize(offset, size)) {
+		offsets.push_back(offset);
+		offset += bytes;
+	}
+
+	return true;
+}
+
+void FlockRecording::close() {
+	file.close();
+	header = nullptr;
+	offsets.clear();
+}
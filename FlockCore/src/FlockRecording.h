@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+
+// flock recordings, one file per run:
+//   RecordingHeader, then frames of RecordedFrame + numBoids * floatsPerBoid floats,
+//   then the frame index (uint64 file offset per frame) & a RecordingFooter pointing at it
+// the file is append only, a recording cut short without an index is still readable
+
+struct RecordingHeader {
+	char magic[4]; // "FLKR"
+	uint32_t version;
+	uint32_t dims; // 2 or 3, which simulation wrote it
+	uint32_t floatsPerBoid;
+};
+
+struct RecordedFrame {
+	uint32_t numBoids;
+	float time; // simulated ms
+	float animClock;
+	float robot[8]; // robot boid position, orientation (w, x, y, z) & animPhase, 3D only
+};
+
+struct RecordingFooter {
+	char magic[4]; // "FLKI"
+	uint32_t numFrames;
+	uint64_t indexOffset;
+};
+
+
+// streams frames to a recording file from a background thread, so recording never waits on disk
+class FlockRecorder {
+public:
+	~FlockRecorder() { close(); }
+
+	bool open(const std::string& path, int dims, int floatsPerBoid);
+
+	// finish writing queued frames, then the index
+	void close();
+
+	bool isOpen() const { return file != nullptr; }
+
+	// floats of the next frame, fill numBoids * floatsPerBoid of them then call submit
+	float* begin(const RecordedFrame& frame);
+	void submit();
+
+	int framesWritten() const { return offsets.size(); }
+	int framesDropped() const { return dropped; }
+
+private:
+	void writeLoop();
+
+	FILE* file = nullptr;
+	int floatsPerBoid = 0;
+	uint64_t written = 0; // bytes so far, ftell is 32 bit on some platforms
+	std::vector<uint64_t> offsets; // written by the writer thread, read after close
+
+	// filled frames wait in queue, written ones go back to the pool to be reused
+	std::vector<char> current;
+	std::deque<std::vector<char>> queue, pool;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool closing = false;
+	int dropped = 0;
+	std::thread writer;
+};
+
+
+// memory mapped recording, frames are read in place
+class FlockRecording {
+public:
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return file.isOpen(); }
+	int dims() const { return header->dims; }
+	int floatsPerBoid() const { return header->floatsPerBoid; }
+	int numFrames() const { return offsets.size(); }
+
+	const RecordedFrame& frame(int f) const { return *(const RecordedFrame*)(file.data() + offsets[f]); }
+	const float* boids(int f) const { return (const float*)(file.data() + offsets[f] + sizeof(RecordedFrame)); }
+
+private:
+	MappedFile file;
+	const RecordingHeader* header = nullptr;
+	std::vector<uint64_t> offsets;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// k-d tree over boid positions for k nearest neighbor queries, rebuilt every frame
+// stored implicitly: a node is a range of items split at its middle item,
+// the children are the halves before & after it
+class KdTree {
+public:
+	// dims 2 splits on x & y only, for a flat flock
+	void build(const std::vector<glm::vec3>& positions, int dims) {
+		numDims = dims;
+
+		items.resize(positions.size());
+		for (int i = 0; i < (int)items.size(); i++) items[i] = i;
+
+		points.resize(positions.size());
+		axis.resize(positions.size());
+		buildRange(positions, 0, items.size());
+
+		// positions in tree order, so searches walk memory in order
+		for (int k = 0; k < (int)items.size(); k++) points[k] = positions[items[k]];
+	}
+
+	// the k boids nearest to p other than skip, nearest first, into out (room for k)
+	// returns how many were found, less than k only if the flock is smaller
+	// wrap is the world size on axes that wrap around (0 = no wrap), as in SpatialGrid
+	int nearest(glm::vec3 p, int k, int skip, int* out, glm::vec3 wrap = glm::vec3(0, 0, 0)) const {
+		Nearest found(k, skip, out, buffer(k));
+		if (k <= 0 || items.empty()) return 0;
+
+		search(p, 0, items.size(), found);
+
+		// images of p across the wrapped edges, when they can be closer than what was found
+		for (int sx = -1; sx <= 1; sx++) {
+			for (int sy = -1; sy <= 1; sy++) {
+				if ((sx == 0 && sy == 0) || (sx != 0 && wrap.x <= 0) || (sy != 0 && wrap.y <= 0)) continue;
+
+				// skip the image if the world box is farther from it than the worst found,
+				// measured only along the shifted axes, an axis that doesn't wrap has no box edge
+				glm::vec3 q = p + glm::vec3(sx * wrap.x, sy * wrap.y, 0);
+				float dx = sx == 0 ? 0 : (q.x < 0 ? -q.x : (q.x > wrap.x ? q.x - wrap.x : 0));
+				float dy = sy == 0 ? 0 : (q.y < 0 ? -q.y : (q.y > wrap.y ? q.y - wrap.y : 0));
+				if (dx * dx + dy * dy < found.worst()) search(q, 0, items.size(), found);
+			}
+		}
+
+		return found.count;
+	}
+
+	int size() const { return items.size(); }
+
+private:
+	// sorted candidates, the farthest is dropped when a closer one comes in
+	struct Nearest {
+		Nearest(int k, int skip, int* out, float* dist2) : k(k), skip(skip), out(out), dist2(dist2) {}
+
+		float worst() const { return count < k ? std::numeric_limits<float>::max() : dist2[k - 1]; }
+
+		void add(int item, float d2) {
+			if (item == skip || d2 >= worst()) return;
+
+			// same boid through another wrap image, keep the nearer of the two
+			for (int j = 0; j < count; j++) {
+				if (out[j] != item) continue;
+				if (dist2[j] <= d2) return;
+				for (count--; j < count; j++) {
+					out[j] = out[j + 1];
+					dist2[j] = dist2[j + 1];
+				}
+				break;
+			}
+
+			int j = std::min(count, k - 1);
+			while (j > 0 && dist2[j - 1] > d2) {
+				out[j] = out[j - 1];
+				dist2[j] = dist2[j - 1];
+				j--;
+			}
+			out[j] = item;
+			dist2[j] = d2;
+			if (count < k) count++;
+		}
+
+		int k, skip;
+		int* out;
+		float* dist2;
+		int count = 0;
+	};
+
+	// distances of the candidates, one buffer per thread so queries can run in parallel
+	static float* buffer(int k) {
+		thread_local std::vector<float> dist2;
+		if ((int)dist2.size() < k) dist2.resize(k);
+		return dist2.data();
+	}
+
+	// split items [begin, end) at the median of its widest axis
+	void buildRange(const std::vector<glm::vec3>& positions, int begin, int end) {
+		if (end - begin <= leafSize) return;
+
+		glm::vec3 lo = positions[items[begin]], hi = lo;
+		for (int k = begin + 1; k < end; k++) {
+			lo = glm::min(lo, positions[items[k]]);
+			hi = glm::max(hi, positions[items[k]]);
+		}
+		glm::vec3 extent = hi - lo;
+		int a = extent.y > extent.x ? 1 : 0;
+		if (numDims == 3 && extent.z > extent[a]) a = 2;
+
+		int mid = (begin + end) / 2;
+		std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+			[&](int i, int j) { return positions[i][a] < positions[j][a]; });
+		axis[mid] = a;
+
+		buildRange(positions, begin, mid);
+		buildRange(positions, mid + 1, end);
+	}
+
+	void search(glm::vec3 p, int begin, int end, Nearest& found) const {
+		if (end - begin <= leafSize) {
+			for (int k = begin; k < end; k++) {
+				glm::vec3 d = points[k] - p;
+				found.add(items[k], glm::dot(d, d));
+			}
+			return;
+		}
+
+		int mid = (begin + end) / 2;
+		glm::vec3 d = points[mid] - p;
+		found.add(items[mid], glm::dot(d, d));
+
+		// the half p is in first, the other only if the split plane is closer than the worst found
+		float toPlane = p[axis[mid]] - points[mid][axis[mid]];
+		if (toPlane < 0) {
+			search(p, begin, mid, found);
+			if (toPlane * toPlane < found.worst()) search(p, mid + 1, end, found);
+		}
+		else {
+			search(p, mid + 1, end, found);
+			if (toPlane * toPlane < found.worst()) search(p, begin, mid, found);
+		}
+	}
+
+	static const int leafSize = 8;
+
+	int numDims = 3;
+	std::vector<int> items;            // boid indices in tree order
+	std::vector<glm::vec3> points;     // their positions
+	std::vector<unsigned char> axis;   // split axis of the node whose middle item is at this index
+};
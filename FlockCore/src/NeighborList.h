@@ -0,0 +1,155 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// verlet neighbor lists: every boid's neighbors within radius + skin, kept across steps
+// a boid missing from a list can only come within radius once some boid moved more than skin / 2,
+// so the lists are only rebuilt then & the rules read them in between
+// each list is sorted by distance at the build, so rules with a smaller radius read only its start
+//
+// a few boids jumping far in one go (wrapping around the world) don't force a rebuild:
+// they get exact lists every step & every other boid checks them too, until there are maxJumped
+class NeighborList {
+public:
+	// call at the start of every step, true if the lists have to be rebuilt before they're read:
+	// never built, radius, skin or flock size changed, or too many boids moved over skin / 2 since the last build
+	// offset(p, q) is the vector from p to q, across any wrapped edges
+	template <typename Offset>
+	bool stale(const std::vector<glm::vec3>& positions, float radius, float skin, Offset offset) {
+		// the stats are for one setting, so they can be compared while tuning the skin
+		if (radius != builtRadius || skin != builtSkin) {
+			steps = 0;
+			rebuilds = 0;
+			builtRadius = radius;
+			builtSkin = skin;
+			built.clear();
+		}
+		steps++;
+
+		if (positions.size() != built.size()) return true;
+
+		float limit = skin * skin / 4;
+		for (int i = 0; i < (int)positions.size(); i++) {
+			if (jumpedSlot[i] >= 0) continue;
+
+			glm::vec3 moved = offset(built[i], positions[i]);
+			if (glm::dot(moved, moved) > limit) {
+				if ((int)jumped.size() == maxJumped) return true;
+				jumpedSlot[i] = jumped.size();
+				jumped.push_back(i);
+			}
+		}
+
+		// exact lists of the jumped boids, from every boid's current position
+		float reach = radius + skin;
+		jumpedLists.resize(jumped.size());
+		for (int s = 0; s < (int)jumped.size(); s++) {
+			int i = jumped[s];
+			std::vector<Entry>& list = jumpedLists[s];
+			list.clear();
+			for (int j = 0; j < (int)positions.size(); j++) {
+				float dist = glm::length(offset(positions[i], positions[j]));
+				if (j != i && dist < reach) list.push_back({ j, dist });
+			}
+			sortByDistance(list.begin(), list.end());
+		}
+
+		return false;
+	}
+
+	// rebuild every boid's list, in parallel
+	// candidates(i, f) calls f(j) for every boid that may be within radius + skin of boid i
+	template <typename Candidates, typename Offset>
+	void build(const std::vector<glm::vec3>& positions, ThreadPool& threadPool, Candidates candidates, Offset offset) {
+		int n = positions.size();
+		float reach = builtRadius + builtSkin;
+		float reach2 = reach * reach;
+		built = positions;
+		jumped.clear();
+		jumpedSlot.assign(n, -1);
+		rebuilds++;
+
+		auto inReach = [&](int i, auto f) {
+			candidates(i, [&](int j) {
+				glm::vec3 d = offset(positions[i], positions[j]);
+				float d2 = glm::dot(d, d);
+				if (j != i && d2 < reach2) f(j, d2);
+			});
+		};
+
+		// count each boid's neighbors, then fill & sort its slice of entries
+		start.assign(n + 1, 0);
+		threadPool.parallelFor(n, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				int count = 0;
+				inReach(i, [&](int, float) { count++; });
+				start[i + 1] = count;
+			}
+		});
+		for (int i = 0; i < n; i++) start[i + 1] += start[i];
+
+		entries.resize(start[n]);
+		threadPool.parallelFor(n, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				Entry* out = entries.data() + start[i];
+				inReach(i, [&](int j, float d2) { *out++ = { j, std::sqrt(d2) }; });
+				sortByDistance(entries.begin() + start[i], entries.begin() + start[i + 1]);
+			}
+		});
+	}
+
+	// call f(j) once for every boid j that may be within radius of boid i now:
+	// the ones on its list that were within radius + skin at the build, & any jumped boid
+	template <typename F>
+	void forEach(int i, float radius, F f) const {
+		float reach = radius + builtSkin;
+
+		if (jumpedSlot[i] >= 0) {
+			for (const Entry& e : jumpedLists[jumpedSlot[i]]) {
+				if (e.dist >= reach) break;
+				f(e.boid);
+			}
+			return;
+		}
+
+		for (int k = start[i]; k < start[i + 1] && entries[k].dist < reach; k++) {
+			if (jumpedSlot[entries[k].boid] < 0) f(entries[k].boid);
+		}
+		for (int j : jumped) f(j);
+	}
+
+	// steps since the radius or skin last changed & how many of them rebuilt the lists
+	// read from other threads for stats
+	std::atomic<int64_t> steps{ 0 }, rebuilds{ 0 };
+
+	static const int maxJumped = 32;
+
+private:
+	// a neighbor & its distance at the build
+	struct Entry {
+		int boid;
+		float dist;
+	};
+
+	template <typename It>
+	static void sortByDistance(It begin, It end) {
+		std::sort(begin, end, [](const Entry& a, const Entry& b) { return a.dist < b.dist; });
+	}
+
+	float builtRadius = -1, builtSkin = -1;
+	std::vector<glm::vec3> built; // positions at the last build
+	std::vector<int> start;       // first entry of each boid's list, size + 1 entries
+	std::vector<Entry> entries;   // every list, one after the other
+
+	// boids that moved over skin / 2 since the build, with their lists from this step
+	std::vector<int> jumped;
+	std::vector<int> jumpedSlot; // index into jumped of each boid, -1 if it hasn't
+	std::vector<std::vector<Entry>> jumpedLists;
+};
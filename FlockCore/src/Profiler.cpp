@@ -0,0 +1,123 @@
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace profile {
+
+const char* name(Phase phase) {
+	static const char* names[NumPhases] = {
+		"resize", "step", "grid", "neighbor search", "separation", "cohesion", "alignment",
+		"turn", "integrate", "wrap", "robot", "draw flock", "draw gui"
+	};
+	return phase >= 0 && phase < NumPhases ? names[phase] : "?";
+}
+
+}
+
+//--------------------------------------------------------------
+Profiler::Profiler() {
+	for (Slot& s : slots) {
+		for (auto& ns : s.ns) ns = 0;
+		s.neighbors = 0;
+	}
+}
+
+// threads are handed slots in the order they first add, shared round robin past numSlots
+Profiler::Slot& Profiler::slot() {
+	static std::atomic<int> nextSlot{ 0 };
+	thread_local int index = nextSlot++ % numSlots;
+	return slots[index];
+}
+
+void Profiler::add(profile::Phase phase, int64_t ns) {
+	slot().ns[phase].fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Profiler::countNeighbors(int64_t n) {
+	slot().neighbors.fetch_add(n, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+void Profiler::endFrame() {
+	if (!enabled) return;
+
+	// sum & clear every thread's slot
+	Frame frame = {};
+	for (Slot& s : slots) {
+		for (int p = 0; p < profile::NumPhases; p++) frame[p] += s.ns[p].exchange(0, std::memory_order_relaxed) / 1e6;
+		frame[profile::NumPhases] += s.neighbors.exchange(0, std::memory_order_relaxed);
+	}
+
+	if (history.size() < historySize) history.push_back(frame);
+	else history[frames % historySize] = frame;
+
+	if (csv) {
+		fprintf(csv, "%lld", (long long)frames);
+		for (int p = 0; p < profile::NumPhases; p++) fprintf(csv, ",%.4f", frame[p]);
+		fprintf(csv, ",%.0f\n", frame[profile::NumPhases]);
+	}
+
+	frames++;
+}
+
+double Profiler::average(profile::Phase phase) const {
+	if (history.empty()) return 0;
+
+	double sum = 0;
+	for (const Frame& f : history) sum += f[phase];
+	return sum / history.size();
+}
+
+double Profiler::p99(profile::Phase phase) const {
+	if (history.empty()) return 0;
+
+	std::vector<double> values(history.size());
+	for (size_t i = 0; i < history.size(); i++) values[i] = history[i][phase];
+
+	size_t k = std::min(values.size() - 1, (size_t)(values.size() * 0.99));
+	std::nth_element(values.begin(), values.begin() + k, values.end());
+	return values[k];
+}
+
+double Profiler::averageNeighbors() const {
+	return average((profile::Phase)profile::NumPhases);
+}
+
+std::string Profiler::report() const {
+	std::string s;
+	char line[128];
+
+	snprintf(line, sizeof(line), "%-17s %8s %8s\n", "phase", "avg ms", "p99 ms");
+	s += line;
+	for (int p = 0; p < profile::NumPhases; p++) {
+		profile::Phase phase = (profile::Phase)p;
+		snprintf(line, sizeof(line), "%-17s %8.3f %8.3f\n", profile::name(phase), average(phase), p99(phase));
+		s += line;
+	}
+	snprintf(line, sizeof(line), "%-17s %8.0f\n", "neighbors visited", averageNeighbors());
+	s += line;
+
+	return s;
+}
+
+//--------------------------------------------------------------
+bool Profiler::openCsv(const std::string& path) {
+	closeCsv();
+
+	csv = fopen(path.c_str(), "w");
+	if (!csv) return false;
+
+	fprintf(csv, "frame");
+	for (int p = 0; p < profile::NumPhases; p++) {
+		std::string column = profile::name((profile::Phase)p);
+		std::replace(column.begin(), column.end(), ' ', '_');
+		fprintf(csv, ",%s_ms", column.c_str());
+	}
+	fprintf(csv, ",neighbors_visited\n");
+	return true;
+}
+
+void Profiler::closeCsv() {
+	if (csv) fclose(csv);
+	csv = nullptr;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace profile {
+	// timed parts of a frame
+	// the per boid phases (neighbors to wrap) add up the time spent on every thread,
+	// step is the wall time of the whole simulation update
+	enum Phase {
+		Resize, Step, Grid, Neighbors, Separation, Cohesion, Alignment,
+		Turn, Integrate, Wrap, Robot, DrawFlock, DrawGui, NumPhases
+	};
+
+	const char* name(Phase phase);
+}
+
+
+// per frame phase times & neighbor counts, with a rolling history & optional csv export
+// off by default, a disabled profiler costs one branch per timed scope
+class Profiler {
+public:
+	Profiler();
+	~Profiler() { closeCsv(); }
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	// add to the current frame, safe from any thread
+	// per boid phases go through a PhaseTimer, which adds once per loop or chunk of boids
+	void add(profile::Phase phase, int64_t ns);
+	void countNeighbors(int64_t n);
+
+	// close the current frame: add it to the history & the csv
+	void endFrame();
+
+	// over the frames in the history, in ms
+	double average(profile::Phase phase) const;
+	double p99(profile::Phase phase) const;
+	double averageNeighbors() const;
+
+	// table of average & p99 per phase, for an on screen readout
+	std::string report() const;
+
+	// one row per frame from now on
+	bool openCsv(const std::string& path);
+	void closeCsv();
+	bool isWritingCsv() const { return csv != nullptr; }
+
+	std::atomic<bool> enabled{ false }; // may be switched while another thread steps the simulation
+
+	static const int historySize = 240;
+
+private:
+	// each thread adds to its own slot, so threads don't contend for one counter
+	static const int numSlots = 64;
+	struct alignas(64) Slot {
+		std::atomic<int64_t> ns[profile::NumPhases];
+		std::atomic<int64_t> neighbors;
+	};
+	Slot& slot();
+
+	std::array<Slot, numSlots> slots;
+
+	// ms per phase, then neighbors, for the last historySize frames
+	typedef std::array<double, profile::NumPhases + 1> Frame;
+	std::vector<Frame> history;
+	int64_t frames = 0;
+
+	FILE* csv = nullptr;
+};
+
+
+// times the enclosing scope into a phase
+class ProfileScope {
+public:
+	ProfileScope(Profiler& p, profile::Phase phase) : profiler(p.enabled ? &p : nullptr), phase(phase) {
+		if (profiler) start = std::chrono::steady_clock::now();
+	}
+
+	~ProfileScope() {
+		if (!profiler) return;
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		profiler->add(phase, ns.count());
+	}
+
+private:
+	Profiler* profiler;
+	profile::Phase phase;
+	std::chrono::steady_clock::time_point start;
+};
+
+
+// times the per boid phases of a loop or chunk of boids into locals, added to the profiler when it goes out of scope
+// each lap reads the clock once & gives the time since the last lap to a phase
+class PhaseTimer {
+public:
+	PhaseTimer(Profiler& p) : profiler(p.enabled ? &p : nullptr) {
+		if (profiler) last = std::chrono::steady_clock::now();
+	}
+
+	~PhaseTimer() {
+		if (!profiler) return;
+		for (int p = 0; p < profile::NumPhases; p++) {
+			if (ns[p] > 0) profiler->add((profile::Phase)p, ns[p]);
+		}
+		profiler->countNeighbors(neighbors);
+	}
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	void lap(profile::Phase phase) {
+		if (!profiler) return;
+		auto now = std::chrono::steady_clock::now();
+		ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+		last = now;
+	}
+
+	void countNeighbors(int n) { neighbors += n; }
+
+private:
+	Profiler* profiler;
+	int64_t ns[profile::NumPhases] = {};
+	int64_t neighbors = 0;
+	std::chrono::steady_clock::time_point last;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "CommandQueue.h"
+#include "TripleBuffer.h"
+
+// steps a simulation on its own thread at a steady rate, apart from the frame rate of the app
+// after every step the simulation's Frame is copied out with sim.snapshot(frame) & published,
+// the app draws the latest one without waiting for a step to finish
+// while it runs, the simulation belongs to the thread: other threads only reach it through post()
+template <typename Sim, typename Frame>
+class SimThread {
+public:
+	typedef std::function<void(Sim&)> Command;
+	typedef std::function<void(Sim&, float)> Step;
+
+	~SimThread() { stop(); }
+
+	// call step(sim, dt) stepsPerSecond times a second, dt is the real time since the last step
+	// the current state is published before the thread starts, so latest() has a frame right away
+	void start(Sim& s, Step f, float stepsPerSecond = 60) {
+		stop();
+		sim = &s;
+		step = std::move(f);
+		period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepsPerSecond));
+
+		sim->snapshot(frames.back());
+		frames.publish();
+
+		thread = std::thread([this] { run(); });
+	}
+
+	// wait for the current step & hand the simulation back to the calling thread
+	// commands still queued are run here, so none are lost
+	void stop() {
+		if (!thread.joinable()) return;
+
+		quit = true;
+		thread.join();
+		quit = false;
+
+		runCommands();
+	}
+
+	bool isRunning() const { return thread.joinable(); }
+
+	// run command on the simulation before its next step, from the thread that started it
+	// waits only if the simulation thread falls a whole queue of commands behind
+	void post(Command command) {
+		while (!commands.push(command)) std::this_thread::yield();
+	}
+
+	// newest published frame, never waits
+	// stays valid & unchanged until the next call
+	const Frame& latest() {
+		frames.update();
+		return frames.front();
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void run() {
+		Clock::time_point last = Clock::now();
+		Clock::time_point next = last + period;
+
+		while (!quit) {
+			std::this_thread::sleep_until(next);
+
+			// a step that ran long starts the next one right away instead of catching up
+			Clock::time_point now = Clock::now();
+			next = std::max(next + period, now);
+			float dt = std::chrono::duration<float>(now - last).count();
+			last = now;
+
+			runCommands();
+			step(*sim, dt);
+
+			sim->snapshot(frames.back());
+			frames.publish();
+		}
+	}
+
+	void runCommands() {
+		Command command;
+		while (commands.pop(command)) command(*sim);
+	}
+
+	Sim* sim = nullptr;
+	Step step;
+	Clock::duration period;
+
+	std::thread thread;
+	std::atomic<bool> quit{ false };
+	CommandQueue<Command> commands;
+	TripleBuffer<Frame> frames;
+};
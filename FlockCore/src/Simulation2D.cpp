@@ -0,0 +1,458 @@
+#include "Simulation2D.h"
+
+
+void Flock2D::turnBoid(int i, glm::vec3 p, float turnSpeed) {
+	// find angle between heading & target point
+	glm::vec3 h = heading(i);
+	glm::vec3 v = glm::normalize(p - position[i]);
+	float dotProduct = glm::dot(h, v);
+	float eps = 0.3;
+
+	if (dotProduct < (1.0 - eps)) {
+		// turn clockwise/counterclockwise depending on axis of rotation
+		glm::vec3 crossProduct = glm::cross(h, v);
+		angularForce[i] = turnSpeed;
+		angularForce[i] *= (crossProduct.z > 0) ? 1 : -1;
+	}
+}
+
+//--------------------------------------------------------------
+Simulation2D::Simulation2D(int numThreads, unsigned seed) :
+	simdLevel(kernels::detect()), threadPool(numThreads), rng(seed) {
+}
+
+float Simulation2D::random(float min, float max) {
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+// create new flock
+void Simulation2D::createFlock(int n) {
+	flock.clear();
+	flock.reserve(n);
+
+	for (int i = 0; i < n; i++) {
+		createBoid();
+	}
+}
+
+// create random new boid within bounds of window
+int Simulation2D::createBoid() {
+	glm::vec3 p = glm::vec3(random(0, width), random(0, height), 0);
+	int i = flock.add(p, random(0, 359));
+
+	// initial speed
+	flock.force[i] = flock.heading(i) * random(params.minSpeed, params.maxSpeed) * 100;
+
+	return i;
+}
+
+// update flock size to n boids
+void Simulation2D::resize(int n) {
+	ProfileScope scope(profiler, profile::Resize);
+
+	// decrease flock size
+	while (flock.size() > n) flock.pop_back();
+
+	// increase flock size, capacity at least doubles so growing a few boids a frame doesn't copy every array each time,
+	// & is kept when shrinking so regrowing doesn't allocate
+	if (n > flock.capacity()) flock.reserve(std::max(n, flock.capacity() * 2));
+	while (flock.size() < n) createBoid();
+}
+
+// push boid away from neighbors NEEDS FIXING
+glm::vec3 Simulation2D::separate(int index, const Flock2D& read, int& visited) {
+	glm::vec3 direction = glm::vec3(0, 0, 0);
+	float numNeighbors = 0;
+
+	glm::vec3 position = read.position[index];
+
+	forNeighbors(index, position, params.separationValue, [&](int i) {
+		visited++;
+		if (i == index) return;
+
+		// determine if boid i is a neighbor (across the window edge too)
+		glm::vec3 offset = grid.offset(position, read.position[i]);
+		float dist = glm::length(offset);
+		if ((dist > 0) && (dist < range(params.separationValue))) {
+
+			// find direction from neighbor to boid
+			glm::vec3 diff = glm::normalize(-offset);
+
+			direction += diff / dist;
+			numNeighbors++;
+		}
+	});
+
+	if (numNeighbors > 0) {
+		direction /= numNeighbors; // avg direction to neighbors
+
+		// return difference between desired pos and current pos
+		return direction;
+	}
+
+	return direction; // 0, 0, 0
+}
+
+// find center of a neighborhood of boids and push them towards it
+glm::vec3 Simulation2D::cohesion(int index, const Flock2D& read, int& visited) {
+	glm::vec3 avgPosition = glm::vec3(0, 0, 0);
+	float numNeighbors = 0;
+
+	glm::vec3 position = read.position[index];
+
+	forNeighbors(index, position, params.neighborDistance, [&](int i) {
+		visited++;
+		if (i == index) return;
+
+		// determine if boid i is a neighbor, use its position on boid's side of the edge
+		glm::vec3 offset = grid.offset(position, read.position[i]);
+		float dist = glm::length(offset);
+		if ((dist > 0) && (dist < range(params.neighborDistance))) {
+			avgPosition += position + offset;
+			numNeighbors++;
+		}
+	});
+
+	if (numNeighbors > 0) {
+		avgPosition /= numNeighbors;
+
+		// return difference between desired pos and current pos
+		return avgPosition - position;
+	}
+
+	return avgPosition; // 0, 0, 0
+}
+
+// get difference between boid velocity & average velocity of neighbors
+glm::vec3 Simulation2D::align(int index, const Flock2D& read, int& visited) {
+	glm::vec3 avgHeading = glm::vec3(0, 0, 0);
+	float avgSpeed = 0;
+	float numNeighbors = 0;
+
+	glm::vec3 position = read.position[index];
+
+	// get velocity of neighboring boids
+	forNeighbors(index, position, params.neighborDistance, [&](int i) {
+		visited++;
+		if (i == index) return;
+
+		// determine if boid i is a neighbor
+		float dist = glm::length(grid.offset(position, read.position[i]));
+		if ((dist > 0) && (dist < range(params.neighborDistance))) {
+			avgHeading += read.heading(i);
+			avgSpeed = glm::length(read.velocity[i]);
+			numNeighbors++;
+		}
+	});
+
+	if (numNeighbors > 0) {
+		// get average velocity of neighbors
+		avgHeading /= numNeighbors;
+		avgSpeed /= numNeighbors;
+
+		// cap boid velocity
+		if (std::abs(glm::length(read.velocity[index])) > params.maxSpeed) avgSpeed = 0;
+
+		glm::vec3 alignForce = avgHeading * avgSpeed;
+
+		return alignForce;
+	}
+
+	return avgHeading; // 0, 0, 0
+}
+
+// separation, cohesion & alignment from one vectorized pass over the grid
+glm::vec3 Simulation2D::simdRules(int index, const Flock2D& read, int& visited) {
+	NeighborQuery q;
+	q.position = read.position[index];
+	q.wrap = glm::vec3(grid.width, grid.height, 0);
+
+	// same ranges as the scalar rules, boid itself is skipped by dist > 0
+	float radius = 0;
+	if (params.sep) {
+		q.sepMax2 = params.separationValue * params.separationValue;
+		radius = std::max(radius, params.separationValue);
+	}
+	if (params.coh) {
+		q.cohMax2 = params.neighborDistance * params.neighborDistance;
+		radius = std::max(radius, params.neighborDistance);
+	}
+	if (params.ali) {
+		q.aliMax2 = params.neighborDistance * params.neighborDistance;
+		radius = std::max(radius, params.neighborDistance);
+	}
+
+	NeighborSums n;
+	grid.queryCells(q.position, radius, [&](int begin, int end) {
+		kernels::accumulate(simdLevel, q, lanes, begin, end, n);
+		visited += end - begin;
+	});
+
+	glm::vec3 force = glm::vec3(0, 0, 0);
+
+	// avg direction away from neighbors
+	if (n.numSeparation > 0) force += n.separation / n.numSeparation;
+
+	// difference between avg position and current pos
+	if (n.numCohesion > 0) force += n.cohesion / n.numCohesion;
+
+	// avg velocity of neighbors
+	if (n.numAlignment > 0) {
+		float avgSpeed = n.speed / n.numAlignment;
+		if (std::abs(glm::length(read.velocity[index])) > params.maxSpeed) avgSpeed = 0;
+
+		force += (n.heading / n.numAlignment) * avgSpeed;
+	}
+
+	return force;
+}
+
+//--------------------------------------------------------------
+// copies into frame reuse its arrays, so a frame stops allocating once the flock stops growing
+void Simulation2D::snapshot(Frame& frame) const {
+	frame.flock = flock;
+	frame.targetPoint = targetPoint;
+}
+
+void Simulation2D::record(FlockRecorder& recorder) {
+	RecordedFrame frame = {};
+	frame.numBoids = flock.size();
+	frame.time = time;
+
+	float* out = recorder.begin(frame);
+	for (int i = 0; i < flock.size(); i++, out += recordedFloats) {
+		out[0] = flock.position[i].x;
+		out[1] = flock.position[i].y;
+		out[2] = flock.position[i].z;
+		out[3] = flock.rotation[i];
+	}
+	recorder.submit();
+}
+
+void Simulation2D::replay(const FlockRecording& recording, int f) {
+	const RecordedFrame& frame = recording.frame(f);
+	const float* in = recording.boids(f);
+	int stride = recording.floatsPerBoid();
+
+	time = frame.time;
+
+	while (flock.size() > (int)frame.numBoids) flock.pop_back();
+	while (flock.size() < (int)frame.numBoids) flock.add(glm::vec3(0, 0, 0));
+
+	flock.setScale(glm::vec3(params.scale, params.scale, params.scale));
+	threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const float* b = in + (size_t)i * stride;
+			flock.position[i] = glm::vec3(b[0], b[1], b[2]);
+			flock.rotation[i] = b[3];
+			flock.velocity[i] = glm::vec3(0, 0, 0);
+			flock.angularVelocity[i] = 0;
+			flock.refresh(i);
+		}
+	});
+}
+
+//--------------------------------------------------------------
+bool Simulation2D::save(const std::string& path) const {
+	CheckpointHeader header = { { 'F', 'L', 'K', 'C' }, checkpointVersion, 2, sizeof(FlockParams2D),
+		(uint32_t)flock.size() };
+
+	CheckpointWriter out(header);
+	out.put(params);
+	out.put(width);
+	out.put(height);
+	out.put(time);
+	out.put(targetPoint);
+	out.put(clock);
+	flock.save(out);
+	return out.save(path);
+}
+
+bool Simulation2D::load(const std::string& path) {
+	CheckpointReader in;
+	if (!in.load(path, 2, sizeof(FlockParams2D))) return false;
+
+	// read into copies, so a damaged checkpoint leaves the simulation untouched
+	FlockParams2D p;
+	float w, h, t;
+	glm::vec3 target;
+	FixedTimestep c;
+	Flock2D f;
+	if (!(in.get(p) && in.get(w) && in.get(h) && in.get(t) && in.get(target) && in.get(c) &&
+		f.load(in, in.header.numBoids))) return false;
+
+	params = p;
+	width = w;
+	height = h;
+	time = t;
+	targetPoint = target;
+	clock = c;
+	flock = std::move(f);
+	return true;
+}
+
+//--------------------------------------------------------------
+int Simulation2D::update(float frameTime) {
+	ProfileScope scope(profiler, profile::Step);
+
+	if (!params.fixedTimestep) {
+		clock.reset();
+		step(frameTime);
+		return 1;
+	}
+
+	clock.dt = params.fixedDt;
+	clock.maxSubsteps = params.maxSubsteps;
+
+	int n = clock.advance(frameTime);
+	for (int s = 0; s < n; s++) step(clock.dt);
+	return n;
+}
+
+void Simulation2D::step(float dt) {
+	time += dt * 1000;
+
+	{
+		ProfileScope scope(profiler, profile::Grid);
+
+		// rebuild neighbor grid, cells sized from the smaller rule radius
+		// the simd pass queries all rules at once, so it gets cells as big as the larger radius
+		float cellSize = std::min(params.neighborDistance, params.separationValue);
+		if (useSimd()) cellSize = std::max(params.neighborDistance, params.separationValue);
+		grid.build(flock.position, width, height, cellSize);
+
+		// lay out positions, headings & speeds in grid order for the simd kernels
+		if (useSimd() && params.startSim && !params.targetMode) {
+			lanes.resize(flock.size());
+			threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+				for (int k = begin; k < end; k++) {
+					int i = grid.items[k];
+					lanes.set(k, flock.position[i], flock.heading(i), glm::length(flock.velocity[i]));
+				}
+			});
+		}
+	}
+
+
+	// k nearest neighbors of every boid, from the positions at the start of the step like the grid
+	if (params.topological && params.startSim && !params.targetMode) findNearest();
+	else if (params.neighborLists && params.startSim && !params.targetMode) updateNeighborLists();
+
+
+	// update all boids in the flock
+	flock.setScale(glm::vec3(params.scale, params.scale, params.scale));
+
+	if (params.multithreaded) {
+		// every boid reads last frame's state, so boids can update in any order
+		previous = flock;
+		threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+			PhaseTimer timer(profiler);
+			for (int i = begin; i < end; i++) updateBoid(i, previous, dt, timer);
+		});
+	}
+	else {
+		// boids later in the flock see the already updated earlier ones
+		PhaseTimer timer(profiler);
+		for (int i = 0; i < flock.size(); i++) updateBoid(i, flock, dt, timer);
+	}
+}
+
+void Simulation2D::findNearest() {
+	{
+		ProfileScope scope(profiler, profile::Grid);
+		tree.build(flock.position, 2);
+	}
+
+	nearestPerBoid = std::max(0, std::min(params.numNearest, flock.size() - 1));
+	nearest.resize((size_t)flock.size() * nearestPerBoid);
+
+	ProfileScope scope(profiler, profile::Neighbors);
+	threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int* out = nearest.data() + (size_t)i * nearestPerBoid;
+			tree.nearest(flock.position[i], nearestPerBoid, i, out, glm::vec3(width, height, 0));
+		}
+	});
+}
+
+void Simulation2D::updateNeighborLists() {
+	// every rule that's on reads the lists, so they reach the larger radius
+	float radius = 0;
+	if (params.sep) radius = std::max(radius, params.separationValue);
+	if (params.coh || params.ali) radius = std::max(radius, params.neighborDistance);
+
+	// wrapped displacements, so crossing an edge doesn't count as a jump
+	auto offset = [this](glm::vec3 p, glm::vec3 q) { return grid.offset(p, q); };
+
+	{
+		ProfileScope scope(profiler, profile::Grid);
+		if (!neighborList.stale(flock.position, radius, params.skin, offset)) return;
+	}
+
+	ProfileScope scope(profiler, profile::Neighbors);
+	float reach = radius + params.skin;
+	neighborList.build(flock.position, threadPool, [&](int i, auto f) { grid.query(flock.position[i], reach, f); }, offset);
+}
+
+// apply flocking rules to boid i, neighbors are read from read
+void Simulation2D::updateBoid(int i, const Flock2D& read, float dt, PhaseTimer& timer) {
+	// target mode - test turn & movement
+	if (params.targetMode) {
+		flock.turnBoid(i, targetPoint, params.turnSpeed);
+		timer.lap(profile::Turn);
+
+		if (params.startSim) flock.force[i] = targetPoint - flock.position[i];
+		else flock.force[i] = glm::vec3(0, 0, 0);
+
+		flock.integrate(i, dt);
+		flock.refresh(i);
+		timer.lap(profile::Integrate);
+		return;
+	}
+
+
+	// flocking simulation
+	if (params.startSim) {
+
+		int visited = 0;
+		if (useSimd()) {
+			// all three rules at once, neighbors from the frame start lanes
+			flock.force[i] += simdRules(i, read, visited);
+			timer.lap(profile::Neighbors);
+		}
+		else {
+			// separation: keep boid a certain distance from neighbors
+			if (params.sep) flock.force[i] += separate(i, read, visited);
+			timer.lap(profile::Separation);
+
+			// cohesion: keep boid a certain distance within neighbors
+			if (params.coh) flock.force[i] += cohesion(i, read, visited);
+			timer.lap(profile::Cohesion);
+
+			// alignment: match boid speed with neighbor's speeds
+			if (params.ali) flock.force[i] += align(i, read, visited);
+			timer.lap(profile::Alignment);
+		}
+		timer.countNeighbors(visited);
+
+		// turn boid towards direction its moving
+		flock.turnBoid(i, flock.position[i] + flock.velocity[i], params.turnSpeed);
+		timer.lap(profile::Turn);
+
+		// integrate
+		flock.integrate(i, dt);
+		timer.lap(profile::Integrate);
+
+
+		// wrap around edges of window
+		glm::vec3& p = flock.position[i];
+		if (p.x < 0) p.x += width;
+		else if (p.x > width) p.x -= width;
+
+		if (p.y < 0) p.y += height;
+		else if (p.y > height) p.y -= height;
+
+		flock.refresh(i);
+		timer.lap(profile::Wrap);
+	}
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "BoidIds.h"
+#include "Checkpoint.h"
+#include "FixedTimestep.h"
+#include "FlockKernels.h"
+#include "FlockRecording.h"
+#include "KdTree.h"
+#include "NeighborList.h"
+#include "Profiler.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+
+// settings of the 2D flock, the app copies its gui values in every frame
+struct FlockParams2D {
+	bool startSim = false;
+	bool targetMode = false;
+	bool sep = true, coh = true, ali = true;
+	bool multithreaded = false;
+	bool simd = false;
+
+	// constant dt substeps instead of one step per frame
+	bool fixedTimestep = false;
+	float fixedDt = 1.0f / 60;
+	int maxSubsteps = 4;
+
+	// topological rules: each boid reacts to its numNearest nearest boids, however far,
+	// instead of every boid within neighborDistance / separationValue
+	bool topological = false;
+	int numNearest = 7;
+
+	// rules read per boid neighbor lists reaching skin further than the rule radii,
+	// rebuilt only once a boid moved more than skin / 2
+	bool neighborLists = false;
+	float skin = 10;
+
+	float scale = 1;
+	float neighborDistance = 20;
+	float separationValue = 250;
+
+	float minSpeed = 25;
+	float maxSpeed = 100;
+	float turnSpeed = 50;
+
+	// compared member by member, the padding bytes between them are unspecified
+	auto members() const {
+		return std::tie(startSim, targetMode, sep, coh, ali, multithreaded, simd, fixedTimestep, fixedDt, maxSubsteps,
+			topological, numNearest, neighborLists, skin, scale, neighborDistance, separationValue,
+			minSpeed, maxSpeed, turnSpeed);
+	}
+
+	bool operator==(const FlockParams2D& o) const { return members() == o.members(); }
+	bool operator!=(const FlockParams2D& o) const { return !(*this == o); }
+};
+
+
+// flock stored as parallel arrays, one entry per boid
+// boids are referred to by their index into the arrays
+class Flock2D {
+public:
+	int size() const { return position.size(); }
+	int capacity() const { return position.capacity(); }
+
+	// add boid at p facing rotation degrees, returns its index
+	int add(glm::vec3 p, float r = 0) {
+		position.push_back(p);
+		velocity.push_back(glm::vec3(0, 0, 0));
+		force.push_back(glm::vec3(0, 0, 0));
+		rotation.push_back(r);
+		angularVelocity.push_back(0);
+		angularForce.push_back(0);
+		headings.push_back(glm::vec3(0, 0, 0));
+		transforms.push_back(glm::mat4(1.0));
+		ids.add(size() - 1);
+		refresh(size() - 1);
+		return size() - 1;
+	}
+
+	// remove boid i in O(1), the last boid takes its index
+	void remove(int i) {
+		ids.remove(i);
+		each([i](auto& a) {
+			a[i] = a.back();
+			a.pop_back();
+		});
+	}
+
+	void pop_back() { remove(size() - 1); }
+
+	void clear() {
+		ids.clear();
+		each([](auto& a) { a.clear(); });
+	}
+
+	// room for n boids, so the flock can grow back up to n without allocating
+	void reserve(int n) {
+		ids.reserve(n);
+		each([n](auto& a) { a.reserve(n); });
+	}
+
+	// stable id of boid i, & the current index of a boid id (-1 once removed)
+	int id(int i) const { return ids.id(i); }
+	int indexOf(int id) const { return ids.index(id); }
+
+	// write every per boid array to a checkpoint, & read them back for n boids
+	void save(CheckpointWriter& out) const {
+		out.put(scale);
+		each([&out](const auto& a) { out.put(a); });
+	}
+
+	bool load(CheckpointReader& in, int n) {
+		bool ok = in.get(scale);
+
+		// every array of n boids must fit in what's left of the file, before any is read
+		size_t perBoid = 0;
+		each([&perBoid](const auto& a) { perBoid += sizeof(a[0]); });
+		if (!ok || (size_t)n > in.remaining() / perBoid) return false;
+
+		each([&](auto& a) { ok = ok && in.get(a, n); });
+
+		ids.clear();
+		ids.reserve(n);
+		for (int i = 0; i < n; i++) ids.add(i);
+		return ok;
+	}
+
+	// get boid's transformation matrix
+	const glm::mat4& getTransform(int i) const { return transforms[i]; }
+
+	// get boid's heading direction
+	glm::vec3 heading(int i) const { return headings[i]; }
+
+	// recompute boid i's cached heading & transform
+	// call after changing its position or rotation
+	void refresh(int i) {
+		glm::mat4 T = glm::translate(glm::mat4(1.0), position[i]);
+		glm::mat4 R = glm::rotate(glm::mat4(1.0), glm::radians(rotation[i]), glm::vec3(0, 0, 1));
+		glm::mat4 S = glm::scale(glm::mat4(1.0), scale);
+
+		headings[i] = glm::normalize(R * glm::vec4(0, -1, 0, 1));
+		transforms[i] = T * R * S;
+	}
+
+	// scale every boid, transforms are only rebuilt when it changes
+	void setScale(glm::vec3 s) {
+		if (s == scale) return;
+		scale = s;
+		for (int i = 0; i < size(); i++) refresh(i);
+	}
+
+	void integrate(int i, float dt) {
+		// update position from velocity & time interval
+		position[i] += heading(i) * glm::length(velocity[i]) * dt;
+
+		// update velocity (from acceleration)
+		glm::vec3 accel = acceleration;
+		accel += (force[i] * 1.0f / mass);
+		velocity[i] += accel * dt;
+
+		// update rotation from angular velocity & time
+		rotation[i] += angularVelocity[i] * dt;
+
+		// update angular velocity (from angular acceleration)
+		float angAccel = angularAcceleration;
+		angAccel += angularForce[i] / mass;
+		angularVelocity[i] += angAccel * dt;
+
+		// multiply final result by the damping factor to sim drag
+		//velocity[i] *= damping;
+		angularVelocity[i] *= angularDamping;
+		angularVelocity[i] *= angularDamping;
+
+		// reset all forces
+		force[i] = glm::vec3(0, 0, 0);
+		angularForce[i] = 0;
+	}
+
+	void turnBoid(int i, glm::vec3 p, float turnSpeed);
+
+	// per boid state
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec3> velocity;
+	std::vector<glm::vec3> force;
+	std::vector<float> rotation;
+	std::vector<float> angularVelocity;
+	std::vector<float> angularForce;
+
+	// derived from position, rotation & scale by refresh()
+	std::vector<glm::vec3> headings;
+	std::vector<glm::mat4> transforms;
+
+	// traits shared by the whole flock
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	float mass = 1.0; // placeholder
+	glm::vec3 acceleration = glm::vec3(0, 0, 0);
+	float damping = 0.99;
+	float angularAcceleration = 0;
+	float angularDamping = .95;
+
+private:
+	// apply f to every per boid array
+	template <typename F>
+	void each(F f) { arrays(*this, f); }
+
+	template <typename F>
+	void each(F f) const { arrays(*this, f); }
+
+	template <typename Flock, typename F>
+	static void arrays(Flock& flock, F f) {
+		f(flock.position);
+		f(flock.velocity);
+		f(flock.force);
+		f(flock.rotation);
+		f(flock.angularVelocity);
+		f(flock.angularForce);
+		f(flock.headings);
+		f(flock.transforms);
+	}
+
+	BoidIds ids;
+};
+
+
+// 2D flocking on a wrapping width x height world, no windowing or drawing
+class Simulation2D {
+public:
+	Simulation2D(int numThreads = std::thread::hardware_concurrency(), unsigned seed = 0);
+
+	// advance the flock by dt seconds
+	void step(float dt);
+
+	// advance by a frame that took frameTime seconds, returns the number of steps taken
+	// one step of frameTime, or fixedDt substeps in fixed timestep mode
+	int update(float frameTime);
+
+	// grow/shrink flock to n boids
+	void resize(int n);
+
+	// write the whole simulation state to a checkpoint file / restore it, false if it can't
+	// the thread pool, simd level & random generator are left as they are
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// what the app draws of the simulation, copied out by snapshot() when it steps on a SimThread
+	struct Frame {
+		Flock2D flock;
+		glm::vec3 targetPoint = glm::vec3(0, 0, 0);
+	};
+
+	void snapshot(Frame& frame) const;
+
+	// append the flock as one frame of a recording
+	void record(FlockRecorder& recorder);
+
+	// set the flock to frame f of a recording, the rules are not run
+	void replay(const FlockRecording& recording, int f);
+
+	// position & rotation of each boid in a recording
+	static const int recordedFloats = 4;
+
+	// replace flock with n random boids
+	void createFlock(int n);
+
+	// random new boid within bounds, returns its index
+	int createBoid();
+
+	float random(float min, float max);
+
+	// apply the rules to boid i, timing each rule & counting the neighbors visited with timer
+	void updateBoid(int i, const Flock2D& read, float dt, PhaseTimer& timer);
+
+	// each rule adds the neighbors it visits to visited
+	glm::vec3 separate(int index, const Flock2D& read, int& visited);
+	glm::vec3 cohesion(int index, const Flock2D& read, int& visited);
+	glm::vec3 align(int index, const Flock2D& read, int& visited);
+	glm::vec3 simdRules(int index, const Flock2D& read, int& visited);
+
+	// k nearest neighbors of every boid into nearest, for the topological rules
+	void findNearest();
+
+	// rebuild the neighbor lists if a boid may have come within range of one not on its list
+	void updateNeighborLists();
+
+	// call f(i) for every boid that may be a neighbor of boid index within radius
+	// the boids in the grid cells around position, on index's neighbor list,
+	// or index's nearest boids in topological mode
+	template <typename F>
+	void forNeighbors(int index, glm::vec3 position, float radius, F f) const {
+		if (params.topological) {
+			const int* n = nearest.data() + (size_t)index * nearestPerBoid;
+			for (int j = 0; j < nearestPerBoid; j++) f(n[j]);
+		}
+		else if (params.neighborLists) {
+			neighborList.forEach(index, radius, f);
+		}
+		else grid.query(position, radius, f);
+	}
+
+	// the vectorized rules need the grid ordered lanes, the other neighbor sources use the scalar rules
+	bool useSimd() const { return params.simd && !params.topological && !params.neighborLists; }
+
+	// neighbor range of a rule with radius, unlimited in topological mode
+	float range(float radius) const { return params.topological ? std::numeric_limits<float>::max() : radius; }
+
+	FlockParams2D params;
+	Flock2D flock;
+	Flock2D previous; // last frame's flock, read by the rules in multithreaded mode
+	glm::vec3 targetPoint = glm::vec3(0, 0, 0);
+	float width = 1024, height = 768;
+	float time = 0; // simulated milliseconds
+
+	SpatialGrid grid; // neighbor lookup, rebuilt each step
+	KdTree tree; // nearest neighbor lookup for topological mode, rebuilt each step
+	std::vector<int> nearest; // nearestPerBoid nearest boids of each boid, nearest first
+	int nearestPerBoid = 0;
+	NeighborList neighborList; // per boid neighbors, kept across steps in neighbor list mode
+	FlockLanes lanes; // flock in grid order for the simd kernels
+	kernels::Level simdLevel;
+	ThreadPool threadPool;
+	FixedTimestep clock;
+	Profiler profiler; // phase timings, off unless enabled
+	std::mt19937 rng;
+};
@@ -0,0 +1,702 @@
+#include "Simulation3D.h"
+#include <cmath>
+
+
+void Flock3D::turnBoid(int i, glm::vec3 p, float turnSpeed) {
+	// find angle between heading & target point
+	glm::vec3 h = heading(i);
+	glm::vec3 v = glm::normalize(p - position[i]);
+	float dotProduct = glm::dot(h, v);
+	float eps = 0.3;
+
+	if (dotProduct < (1.0 - eps)) {
+		// turn about the axis that swings heading onto the target direction
+		glm::vec3 axis = glm::cross(h, v);
+
+		// target straight behind, any axis perpendicular to heading works
+		if (glm::length(axis) < 1e-4) {
+			axis = glm::cross(h, std::abs(h.y) < 0.9 ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0));
+		}
+
+		angularForce[i] = glm::normalize(axis) * turnSpeed;
+	}
+}
+
+//--------------------------------------------------------------
+Simulation3D::Simulation3D(int numThreads, unsigned seed) :
+	simdLevel(kernels::detect()), threadPool(numThreads), rng(seed) {
+}
+
+float Simulation3D::random(float min, float max) {
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+// create new flock
+void Simulation3D::createFlock(int n) {
+	flock.clear();
+	flock.reserve(n);
+
+	for (int i = 0; i < n; i++) {
+		createBoid();
+	}
+}
+
+// create random new boid within bounds
+int Simulation3D::createBoid() {
+	return addBoid(glm::vec3(random(minBounds.x, maxBounds.x),
+		random(minBounds.y, maxBounds.y), random(minBounds.z, maxBounds.z)));
+}
+
+int Simulation3D::addBoid(glm::vec3 p) {
+	glm::vec3 r = glm::vec3(random(0, 359), random(0, 359), random(0, 359));
+	int i = flock.add(p, glm::quat(glm::radians(r)));
+
+	// randomly select starting animation
+	flock.animPhase[i] = random(0, 1);
+
+	// initial speed
+	flock.force[i] = flock.heading(i) * random(params.minSpeed, params.maxSpeed);
+
+	return i;
+}
+
+// update flock size to n boids
+void Simulation3D::resize(int n) {
+	ProfileScope scope(profiler, profile::Resize);
+
+	// decrease flock size
+	while (flock.size() > n) flock.pop_back();
+
+	// increase flock size, capacity at least doubles so growing a few boids a frame doesn't copy every array each time,
+	// & is kept when shrinking so regrowing doesn't allocate
+	if (n > flock.capacity()) flock.reserve(std::max(n, flock.capacity() * 2));
+	while (flock.size() < n) createBoid();
+}
+
+//--------------------------------------------------------------
+// copies into frame reuse its arrays, so a frame stops allocating once the flock stops growing
+void Simulation3D::snapshot(Frame& frame) const {
+	frame.flock = flock;
+	frame.robotBoid = robotBoid;
+	frame.agents = agents;
+	frame.targetPoint = targetPoint;
+	frame.animClock = animClock;
+	frame.numAnimStates = numAnimStates;
+}
+
+void Simulation3D::record(FlockRecorder& recorder) {
+	RecordedFrame frame = {};
+	frame.numBoids = flock.size();
+	frame.time = time;
+	frame.animClock = animClock;
+
+	const RobotBoid& rb = robotBoid;
+	float robot[8] = { rb.position.x, rb.position.y, rb.position.z,
+		rb.orientation.w, rb.orientation.x, rb.orientation.y, rb.orientation.z, rb.animPhase };
+	std::copy(robot, robot + 8, frame.robot);
+
+	float* out = recorder.begin(frame);
+	for (int i = 0; i < flock.size(); i++, out += recordedFloats) {
+		const glm::vec3& p = flock.position[i];
+		const glm::quat& q = flock.orientation[i];
+		out[0] = p.x; out[1] = p.y; out[2] = p.z;
+		out[3] = q.w; out[4] = q.x; out[5] = q.y; out[6] = q.z;
+		out[7] = flock.animPhase[i];
+	}
+	recorder.submit();
+}
+
+void Simulation3D::replay(const FlockRecording& recording, int f) {
+	const RecordedFrame& frame = recording.frame(f);
+	const float* in = recording.boids(f);
+	int stride = recording.floatsPerBoid();
+
+	time = frame.time;
+	animClock = frame.animClock;
+
+	const float* r = frame.robot;
+	robotBoid.position = glm::vec3(r[0], r[1], r[2]);
+	robotBoid.orientation = glm::quat(r[3], r[4], r[5], r[6]);
+	robotBoid.animPhase = r[7];
+	robotBoid.refresh();
+
+	while (flock.size() > (int)frame.numBoids) flock.pop_back();
+	while (flock.size() < (int)frame.numBoids) flock.add(glm::vec3(0, 0, 0));
+
+	flock.setScale(glm::vec3(params.scale, params.scale, params.scale));
+	threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const float* b = in + (size_t)i * stride;
+			flock.position[i] = glm::vec3(b[0], b[1], b[2]);
+			flock.orientation[i] = glm::quat(b[3], b[4], b[5], b[6]);
+			flock.animPhase[i] = b[7];
+			flock.velocity[i] = glm::vec3(0, 0, 0);
+			flock.angularVelocity[i] = glm::vec3(0, 0, 0);
+			flock.refresh(i);
+		}
+	});
+}
+
+//--------------------------------------------------------------
+bool Simulation3D::save(const std::string& path) const {
+	CheckpointHeader header = { { 'F', 'L', 'K', 'C' }, checkpointVersion, 3, sizeof(FlockParams3D),
+		(uint32_t)flock.size() };
+
+	CheckpointWriter out(header);
+	out.put(params);
+	out.put(minBounds);
+	out.put(maxBounds);
+	out.put(time);
+	out.put(animTime);
+	out.put(animClock);
+	out.put(targetPoint);
+	out.put(rbIntegrate);
+	out.put(robotBoid);
+	out.put((uint32_t)agents.size());
+	out.put(agents);
+	out.put(clock);
+	flock.save(out);
+	return out.save(path);
+}
+
+bool Simulation3D::load(const std::string& path) {
+	CheckpointReader in;
+	if (!in.load(path, 3, sizeof(FlockParams3D))) return false;
+
+	// read into copies, so a damaged checkpoint leaves the simulation untouched
+	FlockParams3D p;
+	glm::vec3 minB, maxB, target;
+	float t, aTime, aClock;
+	bool integrate;
+	RobotBoid robot;
+	uint32_t numAgents;
+	std::vector<Agent> a;
+	FixedTimestep c;
+	Flock3D f;
+	if (!(in.get(p) && in.get(minB) && in.get(maxB) && in.get(t) && in.get(aTime) && in.get(aClock) &&
+		in.get(target) && in.get(integrate) && in.get(robot) && in.get(numAgents) && in.get(a, numAgents) &&
+		in.get(c) && f.load(in, in.header.numBoids))) return false;
+
+	params = p;
+	minBounds = minB;
+	maxBounds = maxB;
+	time = t;
+	animTime = aTime;
+	animClock = aClock;
+	targetPoint = target;
+	rbIntegrate = integrate;
+	robotBoid = robot;
+	agents = std::move(a);
+	clock = c;
+	flock = std::move(f);
+	return true;
+}
+
+void Simulation3D::resetRobot() {
+	robotBoid.position = glm::vec3(0, 0, 0);
+	robotBoid.velocity = glm::vec3(0, 0, 0);
+	robotBoid.orientation = glm::quat(1, 0, 0, 0);
+	robotBoid.angularVelocity = glm::vec3(0, 0, 0);
+	robotBoid.refresh();
+}
+
+// agents of a role are removed from the back, so the others keep their places
+void Simulation3D::resizeAgents(int numPredators, int numLeaders) {
+	int predators = 0, leaders = 0;
+	for (const Agent& a : agents) (a.predator ? predators : leaders)++;
+
+	for (int i = agents.size() - 1; i >= 0 && (predators > numPredators || leaders > numLeaders); i--) {
+		int& count = agents[i].predator ? predators : leaders;
+		if (count > (agents[i].predator ? numPredators : numLeaders)) {
+			agents.erase(agents.begin() + i);
+			count--;
+		}
+	}
+
+	for (; predators < numPredators; predators++) createAgent(true);
+	for (; leaders < numLeaders; leaders++) createAgent(false);
+}
+
+// predators are faster than the flock, so they can catch up with a boid
+int Simulation3D::createAgent(bool predator) {
+	Agent a;
+	a.predator = predator;
+	a.range = params.neighborDist;
+	a.strength = params.fleeSpeed;
+	a.speed = predator ? params.maxSpeed * 1.5f : params.maxSpeed;
+	a.boid = RobotBoid(glm::vec3(random(minBounds.x, maxBounds.x),
+		random(minBounds.y, maxBounds.y), random(minBounds.z, maxBounds.z)));
+	a.waypoint = a.boid.position;
+	agents.push_back(a);
+	return agents.size() - 1;
+}
+
+void Simulation3D::updateAgent(Agent& a, float dt) {
+	RobotBoid& b = a.boid;
+	a.retarget -= dt;
+
+	if (a.predator) {
+		// chase a random boid for a few seconds, or until it's gone
+		int i = flock.indexOf(a.target);
+		if ((i < 0 || a.retarget <= 0) && flock.size() > 0) {
+			i = std::uniform_int_distribution<int>(0, flock.size() - 1)(rng);
+			a.target = flock.id(i);
+			a.retarget = random(2, 6);
+		}
+		if (i >= 0) a.waypoint = flock.position[i];
+	}
+	else if (a.retarget <= 0 || glm::distance(b.position, a.waypoint) < 1) {
+		// head somewhere within half the size of bounds from here
+		glm::vec3 half = (maxBounds - minBounds) / 2.0f;
+		a.waypoint = b.position + glm::vec3(random(-half.x, half.x), random(-half.y, half.y), random(-half.z, half.z));
+		if (!params.unbounded) a.waypoint = glm::clamp(a.waypoint, minBounds, maxBounds);
+		a.retarget = random(3, 8);
+	}
+
+	// swing the velocity towards the waypoint at cruising speed & face along it
+	glm::vec3 to = a.waypoint - b.position;
+	glm::vec3 desired = glm::length(to) > 0 ? glm::normalize(to) * a.speed : b.velocity;
+	b.velocity += (desired - b.velocity) * std::min(1.0f, a.turnRate * dt);
+	b.position += b.velocity * dt;
+	if (glm::length(b.velocity) > 0) b.orientation = glm::rotation(glm::vec3(0, 0, -1), glm::normalize(b.velocity));
+
+	wrap(b.position);
+	b.refresh();
+}
+
+void Simulation3D::indexRobots() {
+	robots.clear();
+	if (params.predatorMode || params.leaderMode) {
+		robots.push_back({ robotBoid.position, robotBoid.heading() * glm::length(robotBoid.velocity),
+			params.predatorMode, params.neighborDist, params.fleeSpeed });
+	}
+	for (const Agent& a : agents) {
+		robots.push_back({ a.boid.position, a.boid.heading() * glm::length(a.boid.velocity),
+			a.predator, a.range, a.strength });
+	}
+
+	// leaders also push boids away within separationVal
+	robotPositions.resize(robots.size());
+	robotRange = 0;
+	hasPredators = false;
+	for (int r = 0; r < (int)robots.size(); r++) {
+		robotPositions[r] = robots[r].position;
+		robotRange = std::max(robotRange, robots[r].predator ? robots[r].range : std::max(robots[r].range, params.separationVal));
+		hasPredators = hasPredators || robots[r].predator;
+	}
+	robotHash.build(robotPositions, robotRange);
+}
+
+// the same tests the rules made against the one robot boid, for each robot in range
+void Simulation3D::findRobots(glm::vec3 position, Neighborhood& n) const {
+	n.predators = hasPredators;
+	if (robots.empty()) return;
+
+	robotHash.query(position, robotRange, [&](int r) {
+		const Robot& robot = robots[r];
+		float dist = glm::distance(position, robot.position);
+
+		if (robot.predator) {
+			if ((dist > 0) && (dist < robot.range) && (dist < n.predatorDist)) {
+				n.predator = robot.position;
+				n.predatorDist = dist;
+				n.predatorStrength = robot.strength;
+			}
+			return;
+		}
+
+		if ((dist > 0) && (dist < params.separationVal)) {
+			n.leaderSeparation += glm::normalize(position - robot.position) / dist;
+			n.numLeaderSeparation++;
+		}
+		if ((dist > (modelRadius * 2)) && (dist < robot.range)) {
+			n.leaderCohesion += (robot.position - position) * robot.strength;
+		}
+		if ((dist > 0) && (dist < robot.range)) {
+			n.leaderVelocity += robot.velocity;
+			n.numLeaderAlignment++;
+		}
+	});
+}
+
+void Simulation3D::wrap(glm::vec3& p) const {
+	if (params.unbounded) return;
+
+	if (p.x < minBounds.x) p.x += (maxBounds.x - minBounds.x);
+	else if (p.x > maxBounds.x) p.x -= (maxBounds.x - minBounds.x);
+
+	if (p.y < minBounds.y) p.y += (maxBounds.y - minBounds.y);
+	else if (p.y > maxBounds.y) p.y -= (maxBounds.y - minBounds.y);
+
+	if (p.z < minBounds.z) p.z += (maxBounds.z - minBounds.z);
+	else if (p.z > maxBounds.z) p.z -= (maxBounds.z - minBounds.z);
+}
+
+// ping-pong through the animation states, one every animTime ms
+float Simulation3D::animFrame(float animClock, int numAnimStates, float phase) {
+	float last = numAnimStates - 1;
+	if (last <= 0) return 0;
+
+	float u = std::fmod(animClock + phase * 2 * last, 2 * last);
+	return u <= last ? u : 2 * last - u;
+}
+
+// collect separation, cohesion & alignment sums in one pass over the flock
+Neighborhood Simulation3D::findNeighbors(int index, const Flock3D& read) {
+	Neighborhood n;
+	glm::vec3 position = read.position[index];
+	findRobots(position, n);
+
+	if (!params.sep && !params.coh && !params.ali) return n;
+
+	if (useSimd()) {
+		// same ranges as below, as squared distances
+		float overlap = modelRadius * 2;
+		NeighborQuery q;
+		q.position = position;
+		q.skip = hash.slotOf[index];
+		if (params.sep) {
+			q.sepMax2 = std::min(overlap, params.separationVal) * std::min(overlap, params.separationVal);
+		}
+		if (params.coh) {
+			q.cohMin2 = overlap * overlap;
+			q.cohMax2 = params.neighborDist * params.neighborDist;
+		}
+		if (params.ali) q.aliMax2 = params.neighborDist * params.neighborDist;
+
+		NeighborSums sums;
+		int visited = 0;
+		hash.queryCells(position, ruleRadius(), [&](int begin, int end) {
+			kernels::accumulate(simdLevel, q, lanes, begin, end, sums);
+			visited += end - begin;
+		});
+		n.visited = visited;
+
+		n.separation = sums.separation;
+		n.numSeparation = sums.numSeparation;
+		n.position = sums.cohesion + position * sums.numCohesion;
+		n.numCohesion = sums.numCohesion;
+		n.heading = sums.heading;
+		n.speed = sums.speed;
+		n.numAlignment = sums.numAlignment;
+		return n;
+	}
+
+	float separationRange = range(params.separationVal);
+	float neighborRange = range(params.neighborDist);
+
+	auto visit = [&](int i) {
+		float dist = glm::distance(position, read.position[i]);
+
+		// separation: neighbor is too close, but not on top of the boid where there's no direction away
+		if (params.sep && (dist > 0) && (dist < (modelRadius * 2)) && (dist < separationRange)) {
+
+			// find direction from neighbor to boid
+			glm::vec3 diff = glm::normalize(position - read.position[i]);
+
+			n.separation += diff / dist;
+			n.numSeparation++;
+		}
+
+		// cohesion: neighbor is in range & their spaces aren't overlapping
+		if (params.coh && (dist > (modelRadius * 2)) && (dist < neighborRange)) {
+			n.position += read.position[i];
+			n.numCohesion++;
+		}
+
+		// alignment: neighbor is in range
+		if (params.ali && (dist > 0) && (dist < neighborRange)) {
+			n.heading += read.heading(i);
+			n.speed = glm::length(read.velocity[i]);
+			n.numAlignment++;
+		}
+	};
+
+	// the boid's nearest boids, its neighbor list, or the boids in the cells around it
+	if (params.topological) {
+		const int* nearestBoids = nearest.data() + (size_t)index * nearestPerBoid;
+		for (int j = 0; j < nearestPerBoid; j++) visit(nearestBoids[j]);
+		n.visited = nearestPerBoid;
+	}
+	else if (params.neighborLists) {
+		int visited = 0;
+		neighborList.forEach(index, std::numeric_limits<float>::max(), [&](int i) {
+			visit(i);
+			visited++;
+		});
+		n.visited = visited;
+	}
+	else {
+		int visited = 0;
+		hash.query(position, ruleRadius(), [&](int i) {
+			visited++;
+			if (i != index) visit(i);
+		});
+		n.visited = visited;
+	}
+
+	return n;
+}
+
+// push boid away from neighbors
+glm::vec3 Simulation3D::separate(int index, const Neighborhood& n) {
+	glm::vec3 direction = n.separation;
+	float numNeighbors = n.numSeparation;
+
+	glm::vec3 robotForce = glm::vec3(0, 0, 0);
+	if (n.predators) { // predators: flee from the nearest one
+
+		// check if predator is in range AND getting closer
+		float dist = n.predatorDist;
+		if (dist < flock.predatorDist[index]) {
+
+			// direction away from predator
+			glm::vec3 diff = flock.position[index] - n.predator;
+			robotForce = diff * n.predatorStrength;
+		}
+
+		flock.predatorDist[index] = dist;
+	}
+
+	// leaders: boid is following them, maintain regular separation
+	robotForce += n.leaderSeparation;
+	numNeighbors += n.numLeaderSeparation;
+
+	if (numNeighbors > 0) {
+		// return avg direction away from neighbors
+		direction /= numNeighbors;
+		return direction + robotForce;
+	}
+
+	return robotForce; // no neighbors
+}
+
+// find center of a neighborhood of boids and push them towards it
+glm::vec3 Simulation3D::cohesion(int index, const Neighborhood& n) {
+	glm::vec3 avgPosition = n.position;
+	float numNeighbors = n.numCohesion;
+
+	// leaders have greater say on position of flock
+	glm::vec3 robotForce = n.leaderCohesion;
+
+	if (numNeighbors > 0) {
+		// return direction to avg position
+		avgPosition /= numNeighbors;
+		return (avgPosition - flock.position[index]) + robotForce;
+	}
+
+	return robotForce; // no neighbors
+}
+
+// get difference between boid velocity & average velocity of neighbors
+glm::vec3 Simulation3D::align(int index, const Neighborhood& n) {
+	glm::vec3 avgHeading = n.heading;
+	float avgSpeed = n.speed;
+	float numNeighbors = n.numAlignment + n.numLeaderAlignment;
+
+	// leaders have greater say on velocity of flock
+	glm::vec3 robotForce = n.leaderVelocity;
+
+	if (numNeighbors > 0) {
+		// get average heading, speed of neighbors
+		avgHeading /= numNeighbors;
+		avgSpeed /= numNeighbors;
+
+		// cap boid velocity
+		if (std::abs(glm::length(flock.velocity[index])) > params.maxSpeed) avgSpeed = 0;
+
+		// return avg velocity
+		return (avgHeading * avgSpeed) + robotForce;
+	}
+
+	return robotForce; // no neighbors
+}
+
+//--------------------------------------------------------------
+int Simulation3D::update(float frameTime) {
+	ProfileScope scope(profiler, profile::Step);
+
+	if (!params.fixedTimestep) {
+		clock.reset();
+		step(frameTime);
+		return 1;
+	}
+
+	clock.dt = params.fixedDt;
+	clock.maxSubsteps = params.maxSubsteps;
+
+	int n = clock.advance(frameTime);
+	for (int s = 0; s < n; s++) step(clock.dt);
+	return n;
+}
+
+void Simulation3D::step(float dt) {
+	time += dt * 1000;
+	animTime = 5000 / (10 * params.flapFreq);
+
+	// advance the flap cycle, wrapped so the clock keeps its precision
+	float cycle = 2 * std::max(numAnimStates - 1, 1);
+	animClock = std::fmod(animClock + dt * 1000 / animTime, cycle);
+
+
+	// update robot boid
+	{
+		ProfileScope scope(profiler, profile::Robot);
+		if (rbIntegrate) {
+			robotBoid.integrate(dt);
+		}
+		else if (glm::length(robotBoid.velocity) == 0 && glm::length(robotBoid.angularVelocity) == 0) {
+			rbIntegrate = false;
+		}
+
+		// agents move along with the simulation
+		resizeAgents(params.numPredators, params.numLeaders);
+		if (params.startSim && !params.targetMode) {
+			for (Agent& a : agents) updateAgent(a, dt);
+		}
+		indexRobots();
+	}
+
+
+	// update all boids in the flock
+	flock.setScale(glm::vec3(params.scale, params.scale, params.scale));
+
+	// k nearest neighbors of every boid, from the positions at the start of the step
+	// or the neighbor lists, or the hashed cells, sized so a query covers the cells around a boid
+	if (params.topological && params.startSim && !params.targetMode) findNearest();
+	else if (params.neighborLists && params.startSim && !params.targetMode) updateNeighborLists();
+	else if (params.startSim && !params.targetMode) {
+		ProfileScope scope(profiler, profile::Grid);
+		hash.build(flock.position, ruleRadius());
+
+		// lay out positions, headings & speeds in hash order for the simd kernels
+		if (useSimd()) {
+			lanes.resize(flock.size());
+			threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+				for (int k = begin; k < end; k++) {
+					int i = hash.items[k];
+					lanes.set(k, flock.position[i], flock.heading(i), glm::length(flock.velocity[i]));
+				}
+			});
+		}
+	}
+
+	if (params.multithreaded) {
+		// every boid reads last frame's state, so boids can update in any order
+		previous = flock;
+		threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+			PhaseTimer timer(profiler);
+			for (int i = begin; i < end; i++) updateBoid(i, previous, dt, timer);
+		});
+	}
+	else {
+		// boids later in the flock see the already updated earlier ones
+		PhaseTimer timer(profiler);
+		for (int i = 0; i < flock.size(); i++) updateBoid(i, flock, dt, timer);
+	}
+}
+
+void Simulation3D::findNearest() {
+	{
+		ProfileScope scope(profiler, profile::Grid);
+		tree.build(flock.position, 3);
+	}
+
+	nearestPerBoid = std::max(0, std::min(params.numNearest, flock.size() - 1));
+	nearest.resize((size_t)flock.size() * nearestPerBoid);
+
+	ProfileScope scope(profiler, profile::Neighbors);
+	threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			tree.nearest(flock.position[i], nearestPerBoid, i, nearest.data() + (size_t)i * nearestPerBoid);
+		}
+	});
+}
+
+// every rule that's on reads the same neighbors, so they reach the larger radius
+float Simulation3D::ruleRadius() const {
+	float radius = 0;
+	if (params.sep) radius = std::max(radius, std::min(modelRadius * 2, params.separationVal));
+	if (params.coh || params.ali) radius = std::max(radius, params.neighborDist);
+	return radius;
+}
+
+void Simulation3D::updateNeighborLists() {
+	float radius = ruleRadius();
+	float reach = radius + params.skin;
+	auto offset = [](glm::vec3 p, glm::vec3 q) { return q - p; };
+
+	{
+		ProfileScope scope(profiler, profile::Grid);
+		if (!neighborList.stale(flock.position, radius, params.skin, offset)) return;
+		hash.build(flock.position, reach);
+	}
+
+	ProfileScope scope(profiler, profile::Neighbors);
+	neighborList.build(flock.position, threadPool, [&](int i, auto f) { hash.query(flock.position[i], reach, f); }, offset);
+}
+
+// apply flocking rules to boid i, neighbors are read from read
+void Simulation3D::updateBoid(int i, const Flock3D& read, float dt, PhaseTimer& timer) {
+
+	// target mode - test turn & movement
+	if (params.targetMode) {
+
+		flock.turnBoid(i, targetPoint, params.turnSpeed);
+		timer.lap(profile::Turn);
+
+		if (params.startSim) flock.force[i] = targetPoint - flock.position[i];
+		else flock.force[i] = glm::vec3(0, 0, 0);
+
+		flock.integrate(i, dt);
+		flock.refresh(i);
+		timer.lap(profile::Integrate);
+		return;
+	}
+
+
+	// flocking simulation
+	if (params.startSim) {
+
+		// determine boid movement based on flock algorithm
+		// gather neighbors for all three rules in one pass
+		Neighborhood n = findNeighbors(i, read);
+		timer.countNeighbors(n.visited);
+		timer.lap(profile::Neighbors);
+
+		// separation: keep boid a certain distance from neighbors
+		if (params.sep) flock.force[i] += separate(i, n);
+		timer.lap(profile::Separation);
+
+		// cohesion: keep boid a certain distance within neighbors
+		if (params.coh) flock.force[i] += cohesion(i, n);
+		timer.lap(profile::Cohesion);
+
+		// alignment: match boid speed with neighbor's speeds
+		if (params.ali) flock.force[i] += align(i, n);
+		timer.lap(profile::Alignment);
+
+		// turn boid towards direction its moving
+		flock.turnBoid(i, flock.position[i] + flock.velocity[i], params.turnSpeed);
+		timer.lap(profile::Turn);
+
+		// integrate
+		flock.integrate(i, dt);
+
+		// cap velocity
+		glm::vec3& v = flock.velocity[i];
+		if (glm::length(v) > params.maxSpeed) {
+			v = glm::normalize(v) * params.maxSpeed;
+		}
+		timer.lap(profile::Integrate);
+
+		// wrap around edges of bounds
+		// FOR 3D - MAKE BOUNDS BASED ON CAMERA VIEW?
+		// FAR DISTANCE BOUND BY CAMERA DISTANCE (ZOOM)?
+		// make if position + velocity * dt > bounds, add opposing force? or just wrap around
+		wrap(flock.position[i]);
+
+		flock.refresh(i);
+		timer.lap(profile::Wrap);
+	}
+}
@@ -0,0 +1,544 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "BoidIds.h"
+#include "Checkpoint.h"
+#include "FixedTimestep.h"
+#include "FlockKernels.h"
+#include "FlockRecording.h"
+#include "KdTree.h"
+#include "NeighborList.h"
+#include "Profiler.h"
+#include "SpatialHash.h"
+#include "ThreadPool.h"
+
+// settings of the 3D flock, the app copies its gui values in every frame
+struct FlockParams3D {
+	bool startSim = false;
+	bool targetMode = false;
+	bool sep = true, coh = true, ali = true;
+	bool multithreaded = false;
+	bool simd = false;
+
+	// constant dt substeps instead of one step per frame
+	bool fixedTimestep = false;
+	float fixedDt = 1.0f / 60;
+	int maxSubsteps = 4;
+
+	// robot boid
+	bool predatorMode = false, leaderMode = false;
+
+	// agents besides the robot boid, each is a predator or a leader of its own
+	int numPredators = 0, numLeaders = 0;
+
+	// boids roam freely instead of wrapping around minBounds - maxBounds, which only bounds where new boids start
+	bool unbounded = false;
+
+	// topological rules: each boid reacts to its numNearest nearest boids, however far,
+	// instead of every boid within neighborDist / separationVal
+	bool topological = false;
+	int numNearest = 7;
+
+	// rules read per boid neighbor lists reaching skin further than the rule radii,
+	// rebuilt only once a boid moved more than skin / 2
+	bool neighborLists = false;
+	float skin = 2;
+
+	float scale = 1;
+	float neighborDist = 40;
+	float separationVal = 10;
+	float fleeSpeed = 5;
+
+	float flapFreq = 1;
+	float minSpeed = 1, maxSpeed = 4, turnSpeed = 50;
+
+	// compared member by member, the padding bytes between them are unspecified
+	auto members() const {
+		return std::tie(startSim, targetMode, sep, coh, ali, multithreaded, simd, fixedTimestep, fixedDt, maxSubsteps,
+			predatorMode, leaderMode, numPredators, numLeaders, unbounded, topological, numNearest, neighborLists, skin,
+			scale, neighborDist, separationVal, fleeSpeed, flapFreq, minSpeed, maxSpeed, turnSpeed);
+	}
+
+	bool operator==(const FlockParams3D& o) const { return members() == o.members(); }
+	bool operator!=(const FlockParams3D& o) const { return !(*this == o); }
+};
+
+
+// rotate orientation q by angular velocity w (degrees/sec about world axes) over dt seconds
+inline glm::quat integrateOrientation(glm::quat q, glm::vec3 w, float dt) {
+	float angle = glm::length(w) * dt;
+	if (angle == 0) return q;
+
+	glm::quat spin = glm::angleAxis(glm::radians(angle), glm::normalize(w));
+	return glm::normalize(spin * q);
+}
+
+// boids face down -z in model space
+inline glm::vec3 forward(glm::quat q) {
+	return q * glm::vec3(0, 0, -1);
+}
+
+
+// boid steered by the user, the flock follows or flees from it
+class RobotBoid {
+public:
+	RobotBoid() { refresh(); }
+
+	RobotBoid(glm::vec3 p) {
+		position = p;
+		refresh();
+	}
+
+	// get boid's transformation matrix
+	const glm::mat4& getTransform() const { return transform; }
+
+	// get boid's heading direction
+	glm::vec3 heading() const { return cachedHeading; }
+
+	// recompute cached heading & transform, call after changing position, orientation or scale
+	void refresh() {
+		glm::mat4 T = glm::translate(glm::mat4(1.0), position);
+		glm::mat4 R = glm::toMat4(orientation);
+		glm::mat4 S = glm::scale(glm::mat4(1.0), scale);
+
+		cachedHeading = forward(orientation);
+		transform = T * R * S;
+	}
+
+	void integrate(float dt) {
+		// update position from velocity & time interval
+		position += velocity * dt;
+
+		// update velocity (from acceleration)
+		glm::vec3 accel = acceleration;
+		accel += (force * 1.0f / mass);
+		velocity += accel * dt;
+
+		// update orientation from angular velocity & time
+		orientation = integrateOrientation(orientation, angularVelocity, dt);
+
+		// update angular velocity (from angular acceleration)
+		glm::vec3 angAccel = angularAcceleration;
+		angAccel += angularForce / mass;
+		angularVelocity += angAccel * dt;
+
+		// multiply final result by the damping factor to sim drag
+		velocity *= damping;
+		angularVelocity *= angularDamping;
+		angularVelocity *= angularDamping;
+
+		// reset all forces
+		force = glm::vec3(0, 0, 0);
+		angularForce = glm::vec3(0, 0, 0);
+
+		refresh();
+	}
+
+	// boid traits
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	float mass = 1.0; // placeholder
+
+	// boid animation, offset into the flap cycle
+	float animPhase = 0;
+
+	// 3d motion
+	glm::vec3 velocity = glm::vec3(0, 0, 0);
+	glm::vec3 acceleration = glm::vec3(0, 0, 0);
+	glm::vec3 force = glm::vec3(0, 0, 0);
+	float damping = 0.97;
+
+	// angular motion
+	glm::quat orientation = glm::quat(1, 0, 0, 0);
+	glm::vec3 angularVelocity = glm::vec3(0, 0, 0);
+	glm::vec3 angularAcceleration = glm::vec3(0, 0, 0);
+	glm::vec3 angularForce = glm::vec3(0, 0, 0);
+	float angularDamping = .95;
+
+	// derived from position, orientation & scale by refresh()
+	glm::vec3 cachedHeading;
+	glm::mat4 transform;
+};
+
+
+// robot boid that steers itself: a predator chases a boid of the flock, a leader wanders between waypoints
+// boids within range flee a predator or follow a leader, as they do the robot boid in predator / leader mode
+struct Agent {
+	RobotBoid boid;
+	bool predator = true;
+	float range = 40;    // boids react to it within range, as neighborDist
+	float strength = 5;  // how hard boids flee it or are pulled in, as fleeSpeed
+	float speed = 4;     // cruising speed
+	float turnRate = 2;  // how quickly it swings onto a new course, 1/sec
+
+	int target = -1;                          // id of the boid a predator chases
+	glm::vec3 waypoint = glm::vec3(0, 0, 0);  // where it's heading
+	float retarget = 0;                       // seconds until it picks a new target or waypoint
+};
+
+
+// what boids react to of the robot boid or an agent, gathered once a step
+struct Robot {
+	glm::vec3 position;
+	glm::vec3 velocity;
+	bool predator;
+	float range, strength;
+};
+
+
+// flock stored as parallel arrays, one entry per boid
+// boids are referred to by their index into the arrays
+class Flock3D {
+public:
+	int size() const { return position.size(); }
+	int capacity() const { return position.capacity(); }
+
+	// add boid at p with orientation q, returns its index
+	int add(glm::vec3 p, glm::quat q = glm::quat(1, 0, 0, 0)) {
+		position.push_back(p);
+		velocity.push_back(glm::vec3(0, 0, 0));
+		force.push_back(glm::vec3(0, 0, 0));
+		orientation.push_back(q);
+		angularVelocity.push_back(glm::vec3(0, 0, 0));
+		angularForce.push_back(glm::vec3(0, 0, 0));
+		animPhase.push_back(0);
+		predatorDist.push_back(-std::numeric_limits<float>::infinity());
+		headings.push_back(glm::vec3(0, 0, 0));
+		transforms.push_back(glm::mat4(1.0));
+		ids.add(size() - 1);
+		refresh(size() - 1);
+		return size() - 1;
+	}
+
+	// remove boid i in O(1), the last boid takes its index
+	void remove(int i) {
+		ids.remove(i);
+		each([i](auto& a) {
+			a[i] = a.back();
+			a.pop_back();
+		});
+	}
+
+	void pop_back() { remove(size() - 1); }
+
+	void clear() {
+		ids.clear();
+		each([](auto& a) { a.clear(); });
+	}
+
+	// room for n boids, so the flock can grow back up to n without allocating
+	void reserve(int n) {
+		ids.reserve(n);
+		each([n](auto& a) { a.reserve(n); });
+	}
+
+	// stable id of boid i, & the current index of a boid id (-1 once removed)
+	int id(int i) const { return ids.id(i); }
+	int indexOf(int id) const { return ids.index(id); }
+
+	// write every per boid array to a checkpoint, & read them back for n boids
+	void save(CheckpointWriter& out) const {
+		out.put(scale);
+		each([&out](const auto& a) { out.put(a); });
+	}
+
+	bool load(CheckpointReader& in, int n) {
+		bool ok = in.get(scale);
+
+		// every array of n boids must fit in what's left of the file, before any is read
+		size_t perBoid = 0;
+		each([&perBoid](const auto& a) { perBoid += sizeof(a[0]); });
+		if (!ok || (size_t)n > in.remaining() / perBoid) return false;
+
+		each([&](auto& a) { ok = ok && in.get(a, n); });
+
+		ids.clear();
+		ids.reserve(n);
+		for (int i = 0; i < n; i++) ids.add(i);
+		return ok;
+	}
+
+	// get boid's transformation matrix
+	const glm::mat4& getTransform(int i) const { return transforms[i]; }
+
+	// get boid's heading direction
+	glm::vec3 heading(int i) const { return headings[i]; }
+
+	// recompute boid i's cached heading & transform
+	// call after changing its position or orientation
+	void refresh(int i) {
+		glm::mat4 T = glm::translate(glm::mat4(1.0), position[i]);
+		glm::mat4 R = glm::toMat4(orientation[i]);
+		glm::mat4 S = glm::scale(glm::mat4(1.0), scale);
+
+		headings[i] = forward(orientation[i]);
+		transforms[i] = T * R * S;
+	}
+
+	// scale every boid, transforms are only rebuilt when it changes
+	void setScale(glm::vec3 s) {
+		if (s == scale) return;
+		scale = s;
+		for (int i = 0; i < size(); i++) refresh(i);
+	}
+
+	void integrate(int i, float dt) {
+		// update position from velocity & time interval
+		position[i] += heading(i) * glm::length(velocity[i]) * dt;
+
+		// update velocity (from acceleration)
+		glm::vec3 accel = acceleration;
+		accel += (force[i] * 1.0f / mass);
+		velocity[i] += accel * dt;
+
+		// update orientation from angular velocity & time
+		orientation[i] = integrateOrientation(orientation[i], angularVelocity[i], dt);
+
+		// update angular velocity (from angular acceleration)
+		glm::vec3 angAccel = angularAcceleration;
+		angAccel += angularForce[i] / mass;
+		angularVelocity[i] += angAccel * dt;
+
+		// multiply final result by the damping factor to sim drag
+		velocity[i] *= damping;
+		angularVelocity[i] *= angularDamping;
+		angularVelocity[i] *= angularDamping;
+
+		// reset all forces
+		force[i] = glm::vec3(0, 0, 0);
+		angularForce[i] = glm::vec3(0, 0, 0);
+	}
+
+	void turnBoid(int i, glm::vec3 p, float turnSpeed);
+
+	// per boid motion
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec3> velocity;
+	std::vector<glm::vec3> force;
+	std::vector<glm::quat> orientation;
+	std::vector<glm::vec3> angularVelocity;
+	std::vector<glm::vec3> angularForce;
+
+	// per boid animation, offset into the flap cycle (0-1)
+	std::vector<float> animPhase;
+
+	std::vector<float> predatorDist;
+
+	// derived from position, orientation & scale by refresh()
+	std::vector<glm::vec3> headings;
+	std::vector<glm::mat4> transforms;
+
+	// traits shared by the whole flock
+	glm::vec3 scale = glm::vec3(1, 1, 1);
+	float mass = 1.0; // placeholder
+	glm::vec3 acceleration = glm::vec3(0, 0, 0);
+	float damping = 0.99;
+	glm::vec3 angularAcceleration = glm::vec3(0, 0, 0);
+	float angularDamping = .95;
+
+private:
+	// apply f to every per boid array
+	template <typename F>
+	void each(F f) { arrays(*this, f); }
+
+	template <typename F>
+	void each(F f) const { arrays(*this, f); }
+
+	template <typename Flock, typename F>
+	static void arrays(Flock& flock, F f) {
+		f(flock.position);
+		f(flock.velocity);
+		f(flock.force);
+		f(flock.orientation);
+		f(flock.angularVelocity);
+		f(flock.angularForce);
+		f(flock.animPhase);
+		f(flock.predatorDist);
+		f(flock.headings);
+		f(flock.transforms);
+	}
+
+	BoidIds ids;
+};
+
+
+// neighbor sums for one boid, collected in a single pass over the flock
+struct Neighborhood {
+	// separation: avg direction away from boids that are too close
+	glm::vec3 separation = glm::vec3(0, 0, 0);
+	float numSeparation = 0;
+
+	// cohesion: sum of neighbor positions
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	float numCohesion = 0;
+
+	// alignment: sum of neighbor headings & neighbor speed
+	glm::vec3 heading = glm::vec3(0, 0, 0);
+	float speed = 0;
+	float numAlignment = 0;
+
+	// nearest predator within its range, if there are any predators
+	bool predators = false;
+	glm::vec3 predator = glm::vec3(0, 0, 0);
+	float predatorDist = std::numeric_limits<float>::infinity();
+	float predatorStrength = 0;
+
+	// leaders within range: away from the ones too close, towards & along with the others
+	glm::vec3 leaderSeparation = glm::vec3(0, 0, 0);
+	float numLeaderSeparation = 0;
+	glm::vec3 leaderCohesion = glm::vec3(0, 0, 0);
+	glm::vec3 leaderVelocity = glm::vec3(0, 0, 0);
+	float numLeaderAlignment = 0;
+
+	int visited = 0; // boids looked at, for the profiler
+};
+
+
+// 3D flocking inside a wrapping box with a robot boid & agents, no windowing or drawing
+class Simulation3D {
+public:
+	Simulation3D(int numThreads = std::thread::hardware_concurrency(), unsigned seed = 0);
+
+	// advance the flock, robot boid & agents by dt seconds
+	void step(float dt);
+
+	// advance by a frame that took frameTime seconds, returns the number of steps taken
+	// one step of frameTime, or fixedDt substeps in fixed timestep mode
+	int update(float frameTime);
+
+	// grow/shrink flock to n boids
+	void resize(int n);
+
+	// write the whole simulation state to a checkpoint file / restore it, false if it can't
+	// the thread pool, simd level & random generator are left as they are
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// what the app draws of the simulation, copied out by snapshot() when it steps on a SimThread
+	struct Frame {
+		Flock3D flock;
+		RobotBoid robotBoid;
+		std::vector<Agent> agents;
+		glm::vec3 targetPoint = glm::vec3(0, 0, 0);
+		float animClock = 0;
+		int numAnimStates = 7;
+
+		// as Simulation3D::animFrame, at the time of this frame
+		float animFrame(float phase) const { return Simulation3D::animFrame(animClock, numAnimStates, phase); }
+	};
+
+	void snapshot(Frame& frame) const;
+
+	// append the flock & robot boid as one frame of a recording
+	void record(FlockRecorder& recorder);
+
+	// set the flock & robot boid to frame f of a recording, the rules are not run
+	void replay(const FlockRecording& recording, int f);
+
+	// position, orientation & animPhase of each boid in a recording
+	static const int recordedFloats = 8;
+
+	// replace flock with n random boids
+	void createFlock(int n);
+
+	// random new boid within bounds, returns its index
+	int createBoid();
+
+	// new boid at p with random rotation & speed, returns its index
+	int addBoid(glm::vec3 p);
+
+	// move robot boid back to the center & stop it
+	void resetRobot();
+
+	// add or remove agents until there are numPredators predators & numLeaders leaders
+	void resizeAgents(int numPredators, int numLeaders);
+
+	// new agent at a random point within bounds, returns its index
+	int createAgent(bool predator);
+
+	// steer agent a towards its target boid or waypoint, picking a new one when it's time
+	void updateAgent(Agent& a, float dt);
+
+	// gather the robot boid & agents the flock reacts to into robots & index them
+	void indexRobots();
+
+	// add the robots within range of position to n
+	void findRobots(glm::vec3 position, Neighborhood& n) const;
+
+	// wrap p around the edges of bounds, unless the world is unbounded
+	void wrap(glm::vec3& p) const;
+
+	float random(float min, float max);
+
+	// apply the rules to boid i, timing each rule & counting the neighbors visited with timer
+	void updateBoid(int i, const Flock3D& read, float dt, PhaseTimer& timer);
+
+	// animation frame (0 - numAnimStates-1, fractional) of a boid at phase, see animClock
+	float animFrame(float phase) const { return animFrame(animClock, numAnimStates, phase); }
+	static float animFrame(float animClock, int numAnimStates, float phase);
+	Neighborhood findNeighbors(int index, const Flock3D& read);
+
+	// k nearest neighbors of every boid into nearest, for the topological rules
+	void findNearest();
+
+	// rebuild the neighbor lists if a boid may have come within range of one not on its list
+	void updateNeighborLists();
+
+	// the larger radius of the rules that are on
+	float ruleRadius() const;
+
+	// the vectorized rules read the hash ordered lanes, the other neighbor sources use the scalar rules
+	bool useSimd() const { return params.simd && !params.topological && !params.neighborLists; }
+
+	// neighbor range of a rule with radius, unlimited in topological mode
+	float range(float radius) const { return params.topological ? std::numeric_limits<float>::max() : radius; }
+	glm::vec3 separate(int index, const Neighborhood& n);
+	glm::vec3 cohesion(int index, const Neighborhood& n);
+	glm::vec3 align(int index, const Neighborhood& n);
+
+	FlockParams3D params;
+	Flock3D flock;
+	Flock3D previous; // last frame's flock, read by the rules in multithreaded mode
+	RobotBoid robotBoid;
+	bool rbIntegrate = false;
+	std::vector<Agent> agents;
+	glm::vec3 targetPoint = glm::vec3(0, 0, 0);
+
+	glm::vec3 minBounds = glm::vec3(-30, 0, -30);
+	glm::vec3 maxBounds = glm::vec3(30, 30, 30);
+
+	// from the boid model
+	float modelRadius = 1;
+	int numAnimStates = 7;
+
+	float time = 0; // simulated milliseconds
+	float animTime = 100; // ms per animation state
+
+	// animation states stepped so far, the whole flock shares it & boids only differ by phase
+	// boids flap back & forth through the states, so a cycle is 2 * (numAnimStates - 1) states
+	float animClock = 0;
+
+	SpatialHash hash; // neighbor lookup, rebuilt each step
+	std::vector<Robot> robots; // robot boid & agents the flock reacts to this step
+	std::vector<glm::vec3> robotPositions;
+	SpatialHash robotHash; // robot lookup, cells as wide as robotRange
+	float robotRange = 0; // farthest any robot reaches
+	bool hasPredators = false;
+	FlockLanes lanes; // flock in hash order for the simd kernels
+	KdTree tree; // nearest neighbor lookup for topological mode, rebuilt each step
+	std::vector<int> nearest; // nearestPerBoid nearest boids of each boid, nearest first
+	int nearestPerBoid = 0;
+	NeighborList neighborList; // per boid neighbors, kept across steps in neighbor list mode
+	kernels::Level simdLevel;
+	ThreadPool threadPool;
+	FixedTimestep clock;
+	Profiler profiler; // phase timings, off unless enabled
+	std::mt19937 rng;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// uniform cell grid over the window, rebuilt every frame
+// cells wrap around the edges the same way boid positions do
+class SpatialGrid {
+public:
+	void build(const std::vector<glm::vec3>& positions, float w, float h, float cellSize) {
+		width = w;
+		height = h;
+
+		// cells evenly divide the window so the seam lines up with a cell border
+		cols = std::max(1, (int)(width / std::max(cellSize, 1.0f)));
+		rows = std::max(1, (int)(height / std::max(cellSize, 1.0f)));
+		cellWidth = width / cols;
+		cellHeight = height / rows;
+
+		// counting sort of boid indices by cell
+		int n = (int)positions.size();
+		cellStart.assign(cols * rows + 1, 0);
+		cellOf.resize(n);
+		for (int i = 0; i < n; i++) {
+			cellOf[i] = cellIndex(cellX(positions[i].x), cellY(positions[i].y));
+			cellStart[cellOf[i] + 1]++;
+		}
+		for (int c = 0; c < cols * rows; c++) {
+			cellStart[c + 1] += cellStart[c];
+		}
+
+		items.resize(n);
+		std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+		for (int i = 0; i < n; i++) {
+			items[next[cellOf[i]]++] = i;
+		}
+	}
+
+	// call visit(i) for every boid in the cells within radius of p
+	template <typename F>
+	void query(glm::vec3 p, float radius, F visit) const {
+		queryCells(p, radius, [&](int begin, int end) {
+			for (int k = begin; k < end; k++) visit(items[k]);
+		});
+	}
+
+	// call visit(begin, end) with the range of items of every cell within radius of p
+	template <typename F>
+	void queryCells(glm::vec3 p, float radius, F visit) const {
+		int rx = (int)std::ceil(radius / cellWidth);
+		int ry = (int)std::ceil(radius / cellHeight);
+		int cx = cellX(p.x);
+		int cy = cellY(p.y);
+
+		// if the range wraps onto itself, cover the whole axis once
+		int x0 = cx - rx, x1 = cx + rx;
+		if (x1 - x0 + 1 >= cols) { x0 = 0; x1 = cols - 1; }
+		int y0 = cy - ry, y1 = cy + ry;
+		if (y1 - y0 + 1 >= rows) { y0 = 0; y1 = rows - 1; }
+
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				int c = cellIndex(x, y);
+				if (cellStart[c] < cellStart[c + 1]) visit(cellStart[c], cellStart[c + 1]);
+			}
+		}
+	}
+
+	// shortest vector from p to q, taking the wrap-around into account
+	glm::vec3 offset(glm::vec3 p, glm::vec3 q) const {
+		glm::vec3 d = q - p;
+
+		if (d.x > width / 2) d.x -= width;
+		else if (d.x < -width / 2) d.x += width;
+
+		if (d.y > height / 2) d.y -= height;
+		else if (d.y < -height / 2) d.y += height;
+
+		return d;
+	}
+
+	int cellX(float x) const { return (int)std::floor(x / cellWidth); }
+	int cellY(float y) const { return (int)std::floor(y / cellHeight); }
+
+	int cellIndex(int x, int y) const {
+		x = ((x % cols) + cols) % cols;
+		y = ((y % rows) + rows) % rows;
+		return y * cols + x;
+	}
+
+	float width = 0, height = 0;
+	int cols = 1, rows = 1;
+	float cellWidth = 1, cellHeight = 1;
+	std::vector<int> cellStart; // first item of each cell, cols * rows + 1 entries
+	std::vector<int> items;     // boid indices sorted by cell
+	std::vector<int> cellOf;    // cell of each boid
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// sparse 3D cell index, rebuilt every frame
+// only occupied cells take memory: cells are hashed into a table of about twice as many buckets as boids,
+// so the world can be any size, bounded or not
+// cells that share a bucket are told apart by the distance checks of whoever queries them
+class SpatialHash {
+public:
+	void build(const std::vector<glm::vec3>& positions, float size) {
+		cellSize = std::max(size, 1e-3f);
+
+		int n = positions.size();
+		numBuckets = 1;
+		while (numBuckets < 2 * n) numBuckets *= 2;
+
+		// counting sort of boid indices by bucket
+		bucketStart.assign(numBuckets + 1, 0);
+		bucketOf.resize(n);
+		for (int i = 0; i < n; i++) {
+			Cell c = cell(positions[i]);
+			bucketOf[i] = bucket(c.x, c.y, c.z);
+			bucketStart[bucketOf[i] + 1]++;
+		}
+		for (int b = 0; b < numBuckets; b++) {
+			bucketStart[b + 1] += bucketStart[b];
+		}
+
+		items.resize(n);
+		slotOf.resize(n);
+		std::vector<int> next(bucketStart.begin(), bucketStart.end() - 1);
+		for (int i = 0; i < n; i++) {
+			slotOf[i] = next[bucketOf[i]]++;
+			items[slotOf[i]] = i;
+		}
+	}
+
+	// call visit(i) once for every boid in the buckets of the cells within radius of p
+	template <typename F>
+	void query(glm::vec3 p, float radius, F visit) const {
+		queryCells(p, radius, [&](int begin, int end) {
+			for (int k = begin; k < end; k++) visit(items[k]);
+		});
+	}
+
+	// call visit(begin, end) once with the range of items of every bucket of the cells within radius of p
+	template <typename F>
+	void queryCells(glm::vec3 p, float radius, F visit) const {
+		double cells = std::ceil((double)radius / cellSize);
+		double span = 2 * cells + 1;
+
+		// as many cells as buckets, every bucket is likely hit: take all items as one range
+		if (span * span * span >= numBuckets) {
+			if (!items.empty()) visit(0, (int)items.size());
+			return;
+		}
+
+		// cells can share a bucket, so collect the buckets & visit each once
+		std::vector<int>& buckets = buffer();
+		buckets.clear();
+		Cell c = cell(p);
+		int64_t r = cells;
+		for (int64_t z = c.z - r; z <= c.z + r; z++) {
+			for (int64_t y = c.y - r; y <= c.y + r; y++) {
+				for (int64_t x = c.x - r; x <= c.x + r; x++) buckets.push_back(bucket(x, y, z));
+			}
+		}
+		std::sort(buckets.begin(), buckets.end());
+		buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+
+		for (int b : buckets) {
+			if (bucketStart[b] < bucketStart[b + 1]) visit(bucketStart[b], bucketStart[b + 1]);
+		}
+	}
+
+	// integer cell coordinates of p, in 64 bits & clamped to +-2^60,
+	// so far out or unbounded worlds never overflow them, nor a query reaching cells around them
+	struct Cell {
+		int64_t x, y, z;
+	};
+
+	Cell cell(glm::vec3 p) const {
+		return { coordinate(p.x), coordinate(p.y), coordinate(p.z) };
+	}
+
+	int64_t coordinate(float v) const {
+		const double limit = 1152921504606846976.0; // 2^60
+		double c = std::floor((double)v / cellSize);
+		if (!(c > -limit)) c = -limit; // NaN too
+		if (c > limit) c = limit;
+		return (int64_t)c;
+	}
+
+	int bucket(int64_t x, int64_t y, int64_t z) const {
+		uint64_t h = (uint64_t)x * 73856093u ^ (uint64_t)y * 19349663u ^ (uint64_t)z * 83492791u;
+		return (int)(h & (numBuckets - 1));
+	}
+
+	float cellSize = 1;
+	int numBuckets = 1;
+	std::vector<int> bucketStart; // first item of each bucket, numBuckets + 1 entries
+	std::vector<int> items;       // boid indices sorted by bucket
+	std::vector<int> bucketOf;    // bucket of each boid
+	std::vector<int> slotOf;      // index into items of each boid
+
+private:
+	// bucket list of a query, one per thread so queries can run in parallel
+	static std::vector<int>& buffer() {
+		thread_local std::vector<int> buckets;
+		return buckets;
+	}
+};
@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int numThreads) {
+	for (int i = 1; i < numThreads; i++) {
+		workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	start.notify_all();
+
+	for (std::thread& t : workers) t.join();
+}
+
+void ThreadPool::parallelFor(int n, const std::function<void(int, int)>& fn) {
+	if (n <= 0) return;
+
+	// not worth waking the workers for a handful of items
+	if (workers.empty() || n < 2 * size()) {
+		fn(0, n);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobSize = n;
+		chunkSize = std::max(1, n / (size() * 8)); // several chunks per thread to balance load
+		nextChunk = 0;
+		busy = workers.size();
+		generation++;
+	}
+	start.notify_all();
+
+	// calling thread takes chunks too
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::work() {
+	unsigned seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			start.wait(lock, [&] { return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+		}
+
+		runChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0) done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::runChunks() {
+	while (true) {
+		int begin = nextChunk.fetch_add(chunkSize);
+		if (begin >= jobSize) return;
+
+		(*job)(begin, std::min(begin + chunkSize, jobSize));
+	}
+}
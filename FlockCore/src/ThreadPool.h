@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads used to split loops over the flock
+class ThreadPool {
+public:
+	// defaults to one thread per core, the calling thread counts as one of them
+	ThreadPool(int numThreads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	int size() const { return workers.size() + 1; }
+
+	// run fn(begin, end) over chunks of [0, n), returns once every chunk is done
+	void parallelFor(int n, const std::function<void(int, int)>& fn);
+
+private:
+	void work();
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start, done;
+	bool quit = false;
+	unsigned generation = 0; // bumped for every parallelFor call
+	int busy = 0;            // workers still running the current job
+
+	// current job
+	const std::function<void(int, int)>* job = nullptr;
+	int jobSize = 0;
+	int chunkSize = 1;
+	std::atomic<int> nextChunk{ 0 };
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+
+// hands values from one writer thread to one reader thread without locks
+// the writer fills back() & publishes it, the reader takes the newest published value
+// neither ever waits for the other, values published faster than they're read are skipped
+template <typename T>
+class TripleBuffer {
+public:
+	// writer: the value being filled, not seen by the reader until published
+	T& back() { return buffers[backIndex]; }
+
+	// writer: make back() the newest value & start filling another
+	void publish() {
+		backIndex = middle.exchange(backIndex | fresh, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// reader: take the newest value if one was published since, false if front() is still the newest
+	bool update() {
+		if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+
+	// reader: the value taken by the last update(), left alone by the writer until the next one
+	const T& front() const { return buffers[frontIndex]; }
+
+private:
+	// the middle buffer's index, with the fresh bit while it holds a value the reader hasn't taken
+	static const int indexMask = 3, fresh = 4;
+
+	T buffers[3];
+	int backIndex = 0;  // writer's
+	int frontIndex = 1; // reader's
+	std::atomic<int> middle{ 2 };
+};
@@ -0,0 +1,110 @@
+// what a boid sees of the robot boid & agents through the robot hash, against a loop over all of them
+
+#include <random>
+
+#include "Simulation3D.h"
+#include "Test.h"
+
+// the robot boid & every agent, each tested by the rules of findRobots
+static Neighborhood bruteForce(const Simulation3D& sim, glm::vec3 position) {
+	std::vector<Robot> all;
+	if (sim.params.predatorMode || sim.params.leaderMode) {
+		const RobotBoid& b = sim.robotBoid;
+		all.push_back({ b.position, b.heading() * glm::length(b.velocity), sim.params.predatorMode,
+			sim.params.neighborDist, sim.params.fleeSpeed });
+	}
+	for (const Agent& a : sim.agents) {
+		all.push_back({ a.boid.position, a.boid.heading() * glm::length(a.boid.velocity), a.predator, a.range, a.strength });
+	}
+
+	Neighborhood n;
+	for (const Robot& robot : all) {
+		n.predators = n.predators || robot.predator;
+		float dist = glm::distance(position, robot.position);
+
+		if (robot.predator) {
+			if (dist > 0 && dist < robot.range && dist < n.predatorDist) {
+				n.predator = robot.position;
+				n.predatorDist = dist;
+				n.predatorStrength = robot.strength;
+			}
+			continue;
+		}
+
+		if (dist > 0 && dist < sim.params.separationVal) {
+			n.leaderSeparation += glm::normalize(position - robot.position) / dist;
+			n.numLeaderSeparation++;
+		}
+		if (dist > sim.modelRadius * 2 && dist < robot.range) n.leaderCohesion += (robot.position - position) * robot.strength;
+		if (dist > 0 && dist < robot.range) {
+			n.leaderVelocity += robot.velocity;
+			n.numLeaderAlignment++;
+		}
+	}
+	return n;
+}
+
+static void checkNear(glm::vec3 a, glm::vec3 b) {
+	for (int c = 0; c < 3; c++) CHECK_NEAR(a[c], b[c], 1e-4 * (1 + std::abs(b[c])));
+}
+
+static void checkSame(const Neighborhood& a, const Neighborhood& b) {
+	CHECK(a.predators == b.predators);
+	CHECK(a.predatorDist == b.predatorDist);
+	CHECK(a.predator == b.predator);
+	CHECK(a.predatorStrength == b.predatorStrength);
+	checkNear(a.leaderSeparation, b.leaderSeparation);
+	checkNear(a.leaderCohesion, b.leaderCohesion);
+	checkNear(a.leaderVelocity, b.leaderVelocity);
+	CHECK(a.numLeaderSeparation == b.numLeaderSeparation);
+	CHECK(a.numLeaderAlignment == b.numLeaderAlignment);
+}
+
+// agents spread well past the rule radii, with ranges of their own, so the hash skips most of them
+static void checkAgents(bool predatorMode, bool leaderMode) {
+	Simulation3D sim(1, 7);
+	sim.params.predatorMode = predatorMode;
+	sim.params.leaderMode = leaderMode;
+	sim.params.separationVal = 6;
+	sim.resizeAgents(120, 80);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> u(-150, 150), range(3, 40), strength(1, 8), v(-4, 4);
+	for (Agent& a : sim.agents) {
+		a.boid.position = glm::vec3(u(rng), u(rng), u(rng));
+		a.boid.velocity = glm::vec3(v(rng), v(rng), v(rng));
+		a.range = range(rng);
+		a.strength = strength(rng);
+	}
+	sim.indexRobots();
+
+	// boids close to an agent, on top of one, & anywhere
+	std::uniform_real_distribution<float> near(-12, 12);
+	for (const Agent& a : sim.agents) {
+		for (glm::vec3 p : { a.boid.position + glm::vec3(near(rng), near(rng), near(rng)), a.boid.position,
+				glm::vec3(u(rng), u(rng), u(rng)) }) {
+			Neighborhood n;
+			sim.findRobots(p, n);
+			checkSame(n, bruteForce(sim, p));
+		}
+	}
+}
+
+TEST(agentsMatchBruteForce) {
+	checkAgents(false, false);
+	checkAgents(true, false);
+	checkAgents(false, true);
+}
+
+// without any predator no boid is told to flee
+TEST(agentsLeadersOnly) {
+	Simulation3D sim(1, 7);
+	sim.resizeAgents(0, 5);
+	sim.indexRobots();
+
+	Neighborhood n;
+	sim.findRobots(sim.agents[0].boid.position + glm::vec3(1, 0, 0), n);
+	CHECK(!n.predators);
+	CHECK(n.numLeaderAlignment >= 1);
+	checkSame(n, bruteForce(sim, sim.agents[0].boid.position + glm::vec3(1, 0, 0)));
+}
@@ -0,0 +1,171 @@
+// simulation checkpoints saved & loaded back, & files that must be refused
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <new>
+
+#include "Simulation2D.h"
+#include "Simulation3D.h"
+#include "Test.h"
+
+static const char* checkpointPath = "flockcore_test_checkpoint.bin";
+
+static std::vector<char> readFile() {
+	std::ifstream in(checkpointPath, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::vector<char>& bytes, size_t size) {
+	std::ofstream out(checkpointPath, std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), size);
+}
+
+// a loaded simulation steps on exactly as the saved one does
+template <typename Sim>
+static void checkSameSteps(Sim& a, Sim& b) {
+	for (int s = 0; s < 20; s++) {
+		a.step(1.0f / 60);
+		b.step(1.0f / 60);
+	}
+	CHECK(a.flock.size() == b.flock.size());
+	CHECK(a.flock.position == b.flock.position);
+	CHECK(a.flock.velocity == b.flock.velocity);
+}
+
+// every truncation & a wrong magic is refused, leaving the simulation as it was
+template <typename Sim>
+static void checkRefused(Sim& sim) {
+	std::vector<char> bytes = readFile();
+	std::vector<glm::vec3> before = sim.flock.position;
+
+	for (size_t size : { (size_t)0, (size_t)3, sizeof(CheckpointHeader), bytes.size() / 2, bytes.size() - 1 }) {
+		writeFile(bytes, size);
+		CHECK(!sim.load(checkpointPath));
+		CHECK(sim.flock.position == before);
+	}
+
+	std::vector<char> wrongMagic = bytes;
+	wrongMagic[0] = 'X';
+	writeFile(wrongMagic, wrongMagic.size());
+	CHECK(!sim.load(checkpointPath));
+	CHECK(sim.flock.position == before);
+
+	// a header claiming more boids than the file holds
+	for (uint32_t numBoids : { 41u, 100000u, 0xffffffffu }) {
+		std::vector<char> tooMany = bytes;
+		memcpy(tooMany.data() + offsetof(CheckpointHeader, numBoids), &numBoids, sizeof(numBoids));
+		writeFile(tooMany, tooMany.size());
+		CHECK(!sim.load(checkpointPath));
+		CHECK(sim.flock.position == before);
+	}
+}
+
+TEST(checkpoint2DRoundTrip) {
+	Simulation2D saved(1, 7);
+	saved.params.startSim = true;
+	saved.params.neighborDistance = 33;
+	saved.params.simd = true;
+	saved.createFlock(150);
+	for (int s = 0; s < 10; s++) saved.step(1.0f / 60);
+	CHECK(saved.save(checkpointPath));
+
+	Simulation2D loaded(1, 99);
+	CHECK(loaded.load(checkpointPath));
+	CHECK(loaded.params == saved.params);
+	CHECK(loaded.flock.position == saved.flock.position);
+	checkSameSteps(saved, loaded);
+
+	std::remove(checkpointPath);
+}
+
+TEST(checkpoint3DRoundTrip) {
+	Simulation3D saved(1, 7);
+	saved.params.startSim = true;
+	saved.params.separationVal = 6;
+	saved.params.predatorMode = true;
+	saved.createFlock(150);
+	for (int s = 0; s < 10; s++) saved.step(1.0f / 60);
+	CHECK(saved.save(checkpointPath));
+
+	Simulation3D loaded(1, 99);
+	CHECK(loaded.load(checkpointPath));
+	CHECK(loaded.params == saved.params);
+	CHECK(loaded.flock.position == saved.flock.position);
+	CHECK(loaded.robotBoid.position == saved.robotBoid.position);
+	checkSameSteps(saved, loaded);
+
+	std::remove(checkpointPath);
+}
+
+TEST(checkpoint3DKeepsAgents) {
+	Simulation3D saved(1, 7);
+	saved.params.startSim = true;
+	saved.params.numPredators = 3;
+	saved.params.numLeaders = 2;
+	saved.createFlock(50);
+	for (int s = 0; s < 10; s++) saved.step(1.0f / 60);
+	CHECK(saved.save(checkpointPath));
+
+	Simulation3D loaded(1, 99);
+	CHECK(loaded.load(checkpointPath));
+	CHECK(loaded.agents.size() == 5);
+	for (int a = 0; a < (int)loaded.agents.size() && a < (int)saved.agents.size(); a++) {
+		CHECK(loaded.agents[a].predator == saved.agents[a].predator);
+		CHECK(loaded.agents[a].boid.position == saved.agents[a].boid.position);
+	}
+
+	std::remove(checkpointPath);
+}
+
+TEST(checkpoint2DRefusesDamagedFiles) {
+	Simulation2D sim(1, 7);
+	sim.createFlock(40);
+	CHECK(sim.save(checkpointPath));
+	sim.createFlock(40);
+	checkRefused(sim);
+	std::remove(checkpointPath);
+}
+
+TEST(checkpoint3DRefusesDamagedFiles) {
+	Simulation3D sim(1, 7);
+	sim.params.numPredators = 2;
+	sim.createFlock(40);
+	sim.step(1.0f / 60);
+	CHECK(sim.save(checkpointPath));
+	sim.createFlock(40);
+	checkRefused(sim);
+	std::remove(checkpointPath);
+}
+
+// params compare member by member, whatever their padding bytes hold
+TEST(paramsCompareMembers) {
+	alignas(FlockParams2D) unsigned char bytes2D[sizeof(FlockParams2D)];
+	alignas(FlockParams3D) unsigned char bytes3D[sizeof(FlockParams3D)];
+	memset(bytes2D, 0xab, sizeof(bytes2D));
+	memset(bytes3D, 0xab, sizeof(bytes3D));
+	FlockParams2D& a2D = *new (bytes2D) FlockParams2D;
+	FlockParams3D& a3D = *new (bytes3D) FlockParams3D;
+
+	FlockParams2D b2D;
+	FlockParams3D b3D;
+	CHECK(a2D == b2D);
+	CHECK(a3D == b3D);
+
+	b2D.neighborLists = true;
+	b3D.numLeaders = 3;
+	CHECK(a2D != b2D);
+	CHECK(a3D != b3D);
+}
+
+// a 2D checkpoint isn't loaded into a 3D simulation
+TEST(checkpointWrongDims) {
+	Simulation2D sim2D(1, 7);
+	sim2D.createFlock(10);
+	CHECK(sim2D.save(checkpointPath));
+
+	Simulation3D sim3D(1, 7);
+	CHECK(!sim3D.load(checkpointPath));
+	std::remove(checkpointPath);
+}
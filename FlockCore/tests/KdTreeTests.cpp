@@ -0,0 +1,89 @@
+// k nearest neighbors from the tree against a brute force search, with & without wrapped edges
+
+#include <algorithm>
+#include <random>
+
+#include "KdTree.h"
+#include "Test.h"
+
+static const float width = 200, height = 100;
+
+// squared distance the short way round, on the axes that wrap
+static float distance2(glm::vec3 a, glm::vec3 b, glm::vec3 wrap) {
+	glm::vec3 d = glm::abs(a - b);
+	for (int c = 0; c < 3; c++) {
+		if (wrap[c] > 0) d[c] = std::min(d[c], wrap[c] - d[c]);
+	}
+	return glm::dot(d, d);
+}
+
+// boids crowded along the edges, so many nearest neighbors are across the seam
+static std::vector<glm::vec3> seamFlock(int n, std::mt19937& rng) {
+	std::uniform_real_distribution<float> edge(0, 4), x(0, width), y(0, height), coin(0, 1);
+	std::vector<glm::vec3> positions(n);
+	for (glm::vec3& p : positions) {
+		p = glm::vec3(x(rng), y(rng), 0);
+		if (coin(rng) < 0.4f) p.x = coin(rng) < 0.5f ? edge(rng) : width - edge(rng);
+		if (coin(rng) < 0.4f) p.y = coin(rng) < 0.5f ? edge(rng) : height - edge(rng);
+	}
+	return positions;
+}
+
+// every boid's k nearest match the brute force distances, each boid listed once & never itself
+static void checkNearest(const std::vector<glm::vec3>& positions, int k, glm::vec3 wrap) {
+	KdTree tree;
+	tree.build(positions, 2);
+	int n = (int)positions.size();
+	std::vector<int> out(k);
+
+	for (int i = 0; i < n; i++) {
+		int found = tree.nearest(positions[i], k, i, out.data(), wrap);
+		CHECK(found == std::min(k, n - 1));
+
+		std::vector<float> expected;
+		for (int j = 0; j < n; j++) {
+			if (j != i) expected.push_back(distance2(positions[i], positions[j], wrap));
+		}
+		std::sort(expected.begin(), expected.end());
+
+		for (int j = 0; j < found; j++) {
+			CHECK(out[j] != i);
+			CHECK(std::count(out.begin(), out.begin() + found, out[j]) == 1);
+			float d2 = distance2(positions[i], positions[out[j]], wrap);
+			CHECK_NEAR(d2, expected[j], 1e-3 * (1 + expected[j]));
+		}
+	}
+}
+
+TEST(kdTreeMatchesBruteForce) {
+	std::mt19937 rng(1);
+	for (int n : { 2, 3, 9, 17, 100, 600 }) {
+		std::vector<glm::vec3> positions = seamFlock(n, rng);
+		for (int k : { 1, 4, 7, 20 }) checkNearest(positions, k, glm::vec3(0, 0, 0));
+	}
+}
+
+TEST(kdTreeWrapsAcrossSeams) {
+	std::mt19937 rng(2);
+	for (int n : { 2, 3, 9, 17, 100, 600 }) {
+		std::vector<glm::vec3> positions = seamFlock(n, rng);
+		for (int k : { 1, 4, 7, 20 }) {
+			checkNearest(positions, k, glm::vec3(width, height, 0));
+			checkNearest(positions, k, glm::vec3(width, 0, 0));
+		}
+	}
+}
+
+// a sparse flock, where the nearest boid is often seen directly & again, nearer, through a wrap image
+TEST(kdTreeKeepsNearerWrapImage) {
+	std::vector<glm::vec3> positions = {
+		glm::vec3(1, 50, 0), glm::vec3(width - 1, 50, 0), glm::vec3(100, 50, 0), glm::vec3(60, 10, 0),
+	};
+	checkNearest(positions, 3, glm::vec3(width, height, 0));
+
+	KdTree tree;
+	tree.build(positions, 2);
+	int out[3];
+	CHECK(tree.nearest(positions[0], 3, 0, out, glm::vec3(width, height, 0)) == 3);
+	CHECK(out[0] == 1);
+}
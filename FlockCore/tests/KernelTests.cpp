@@ -0,0 +1,103 @@
+// the vectorized neighbor kernels against the scalar one
+
+#include <random>
+
+#include "FlockKernels.h"
+#include "Test.h"
+
+// random lanes within a 100 wide box
+static FlockLanes randomLanes(int n, std::mt19937& rng) {
+	std::uniform_real_distribution<float> u(0, 100), h(-1, 1), s(1, 4);
+	FlockLanes lanes;
+	lanes.resize(n);
+	for (int k = 0; k < n; k++) {
+		lanes.set(k, glm::vec3(u(rng), u(rng), u(rng)), glm::vec3(h(rng), h(rng), h(rng)), s(rng));
+	}
+	return lanes;
+}
+
+// one query of every rule, ranges wide enough to count a good share of the lanes
+static NeighborQuery query(glm::vec3 p, int skip, bool wrap) {
+	NeighborQuery q;
+	q.position = p;
+	q.skip = skip;
+	q.sepMax2 = 20 * 20;
+	q.cohMin2 = 5 * 5;
+	q.cohMax2 = 40 * 40;
+	q.aliMax2 = 30 * 30;
+	if (wrap) q.wrap = glm::vec3(100, 100, 0);
+	return q;
+}
+
+static void checkSums(const NeighborSums& a, const NeighborSums& b) {
+	auto tolerance = [](float v) { return 1e-3 * (1 + std::abs(v)); };
+	for (int c = 0; c < 3; c++) {
+		CHECK_NEAR(a.separation[c], b.separation[c], tolerance(b.separation[c]));
+		CHECK_NEAR(a.cohesion[c], b.cohesion[c], tolerance(b.cohesion[c]));
+		CHECK_NEAR(a.heading[c], b.heading[c], tolerance(b.heading[c]));
+	}
+	CHECK(a.numSeparation == b.numSeparation);
+	CHECK(a.numCohesion == b.numCohesion);
+	CHECK(a.numAlignment == b.numAlignment);
+	CHECK(a.speed == b.speed);
+}
+
+// sizes around the 4 & 8 lane widths, so the leftover lanes are covered
+TEST(kernelsMatchScalar) {
+	std::mt19937 rng(1);
+	int sizes[] = { 1, 2, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 31, 100, 257, 1003 };
+
+	for (int n : sizes) {
+		FlockLanes lanes = randomLanes(n, rng);
+		for (bool wrap : { false, true }) {
+			for (int i = 0; i < n; i += std::max(1, n / 7)) {
+				NeighborQuery q = query(glm::vec3(lanes.x[i], lanes.y[i], lanes.z[i]), i, wrap);
+
+				// the whole range & one that starts & ends off the lane width
+				int begins[] = { 0, std::min(n, 3) }, ends[] = { n, std::max(std::min(n, 3), n - 2) };
+				for (int r = 0; r < 2; r++) {
+					NeighborSums scalar, sse4, avx2;
+					kernels::accumulate(kernels::Scalar, q, lanes, begins[r], ends[r], scalar);
+					kernels::accumulate(kernels::SSE4, q, lanes, begins[r], ends[r], sse4);
+					kernels::accumulate(kernels::AVX2, q, lanes, begins[r], ends[r], avx2);
+					checkSums(sse4, scalar);
+					checkSums(avx2, scalar);
+				}
+			}
+		}
+	}
+
+	printf("  kernels up to %s\n", kernels::name(kernels::detect()));
+}
+
+// sums carried across calls, as the grid & hash queries do one range of lanes at a time
+TEST(kernelsAccumulateAcrossRanges) {
+	std::mt19937 rng(2);
+	FlockLanes lanes = randomLanes(203, rng);
+	NeighborQuery q = query(glm::vec3(50, 50, 50), 17, true);
+
+	for (kernels::Level level : { kernels::Scalar, kernels::SSE4, kernels::AVX2 }) {
+		NeighborSums whole, pieces;
+		kernels::accumulate(kernels::Scalar, q, lanes, 0, lanes.size(), whole);
+		for (int begin = 0; begin < lanes.size(); begin += 13) {
+			kernels::accumulate(level, q, lanes, begin, std::min(begin + 13, lanes.size()), pieces);
+		}
+		checkSums(pieces, whole);
+	}
+}
+
+// a neighbor exactly on the boid has no direction away, it must not turn the sums into NaN
+TEST(kernelsSkipCoincidentNeighbors) {
+	std::mt19937 rng(3);
+	FlockLanes lanes = randomLanes(37, rng);
+	glm::vec3 p(lanes.x[5], lanes.y[5], lanes.z[5]);
+	lanes.set(20, p, glm::vec3(0, 1, 0), 2);
+	lanes.set(21, p + glm::vec3(3, 0, 0), glm::vec3(0, 1, 0), 2);
+
+	for (kernels::Level level : { kernels::Scalar, kernels::SSE4, kernels::AVX2 }) {
+		NeighborSums sums;
+		kernels::accumulate(level, query(p, 5, false), lanes, 0, lanes.size(), sums);
+		for (int c = 0; c < 3; c++) CHECK(std::isfinite(sums.separation[c]));
+		CHECK(sums.numSeparation > 0);
+	}
+}
@@ -0,0 +1,156 @@
+// neighbor lists against the grid & hash they stand in for, & when they're rebuilt
+
+#include <algorithm>
+#include <random>
+
+#include "NeighborList.h"
+#include "Simulation2D.h"
+#include "Simulation3D.h"
+#include "Test.h"
+
+static const int numSteps = 40;
+
+// the same flock stepped with & without lists, boids read last step's flock so the order they're found in
+// only changes the rounding of the sums
+// alignment is off, it takes the speed of the last neighbor found, so it depends on that order
+template <typename Sim>
+static void checkSameFlock(Sim& grid, Sim& lists, float tolerance) {
+	for (int s = 0; s < numSteps; s++) {
+		grid.step(1.0f / 60);
+		lists.step(1.0f / 60);
+	}
+
+	CHECK(lists.flock.size() == grid.flock.size());
+	float worst = 0;
+	for (int i = 0; i < grid.flock.size() && i < lists.flock.size(); i++) {
+		worst = std::max(worst, glm::length(lists.flock.position[i] - grid.flock.position[i]));
+		worst = std::max(worst, glm::length(lists.flock.velocity[i] - grid.flock.velocity[i]));
+	}
+	CHECK_NEAR(worst, 0, tolerance);
+
+	CHECK(lists.neighborList.steps == numSteps);
+	CHECK(lists.neighborList.rebuilds >= 1);
+	CHECK(lists.neighborList.rebuilds < numSteps);
+}
+
+TEST(neighborLists2DMatchGrid) {
+	Simulation2D grid(2, 7), lists(2, 7);
+	for (Simulation2D* sim : { &grid, &lists }) {
+		sim->params.startSim = true;
+		sim->params.multithreaded = true;
+		sim->params.ali = false;
+		sim->params.neighborDistance = 40;
+		sim->params.separationValue = 25;
+		sim->width = 400;
+		sim->height = 300;
+		sim->createFlock(400);
+	}
+	lists.params.neighborLists = true;
+	lists.params.skin = 10;
+	checkSameFlock(grid, lists, 1e-3f);
+}
+
+TEST(neighborLists3DMatchHash) {
+	Simulation3D hash(2, 7), lists(2, 7);
+	for (Simulation3D* sim : { &hash, &lists }) {
+		sim->params.startSim = true;
+		sim->params.multithreaded = true;
+		sim->params.ali = false;
+		sim->params.neighborDist = 10;
+		sim->params.separationVal = 6;
+		sim->createFlock(400);
+	}
+	lists.params.neighborLists = true;
+	lists.params.skin = 0.5f;
+	checkSameFlock(hash, lists, 1e-4f);
+}
+
+// without a skin every step moves more boids than the lists let jump, so each step rebuilds
+TEST(neighborListsWithoutSkinRebuildEveryStep) {
+	Simulation2D sim(2, 7);
+	sim.params.startSim = true;
+	sim.createFlock(300);
+	sim.step(1.0f / 60); // new boids only get their speed in the first step
+
+	sim.params.neighborLists = true;
+	sim.params.skin = 0;
+	for (int s = 0; s < 10; s++) sim.step(1.0f / 60);
+
+	CHECK(sim.neighborList.steps == 10);
+	CHECK(sim.neighborList.rebuilds == 10);
+
+	// & a new skin starts the counts again
+	sim.params.skin = 5;
+	sim.step(1.0f / 60);
+	CHECK(sim.neighborList.steps == 1);
+	CHECK(sim.neighborList.rebuilds == 1);
+}
+
+// boids on a 10 apart lattice, lists reaching radius 12 + skin 4
+struct LatticeLists {
+	static const int side = 10;
+	const float radius = 12, skin = 4;
+
+	std::vector<glm::vec3> positions;
+	NeighborList lists;
+	ThreadPool threadPool{ 2 };
+
+	static glm::vec3 offset(glm::vec3 p, glm::vec3 q) { return q - p; }
+
+	LatticeLists() {
+		for (int x = 0; x < side; x++) {
+			for (int y = 0; y < side; y++) positions.push_back(glm::vec3(x * 10, y * 10, 0));
+		}
+		CHECK(lists.stale(positions, radius, skin, offset));
+		rebuild();
+	}
+
+	void rebuild() {
+		int n = positions.size();
+		lists.build(positions, threadPool, [n](int, auto f) { for (int j = 0; j < n; j++) f(j); }, offset);
+	}
+
+	bool stale() { return lists.stale(positions, radius, skin, offset); }
+
+	// every boid within radius now is found, so the lists can be read instead of a search
+	void checkComplete() {
+		for (int i = 0; i < (int)positions.size(); i++) {
+			std::vector<int> found;
+			lists.forEach(i, radius, [&](int j) { found.push_back(j); });
+			for (int j = 0; j < (int)positions.size(); j++) {
+				if (j != i && glm::length(positions[j] - positions[i]) < radius) {
+					CHECK(std::count(found.begin(), found.end(), j) == 1);
+				}
+			}
+		}
+	}
+};
+
+TEST(neighborListsHalfSkinTrigger) {
+	LatticeLists l;
+	CHECK(l.lists.rebuilds == 1);
+
+	// every boid moving just under skin / 2 keeps the lists, & they still hold every neighbor
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> angle(0, 6.283f);
+	for (glm::vec3& p : l.positions) {
+		float a = angle(rng);
+		p += glm::vec3(std::cos(a), std::sin(a), 0) * (l.skin / 2 * 0.99f);
+	}
+	CHECK(!l.stale());
+	l.checkComplete();
+
+	// a few boids jumping far are patched in without a rebuild
+	for (int i = 0; i < NeighborList::maxJumped; i++) l.positions[i * 3] += glm::vec3(37, 23, 0);
+	CHECK(!l.stale());
+	l.checkComplete();
+
+	// one more boid over skin / 2 is too many jumped ones
+	l.positions[1] += glm::vec3(l.skin, 0, 0);
+	CHECK(l.stale());
+	l.rebuild();
+	CHECK(l.lists.rebuilds == 2);
+	CHECK(!l.stale());
+	l.checkComplete();
+	CHECK(l.lists.steps == 5);
+}
@@ -0,0 +1,122 @@
+// flock recordings written & mapped back, whole, cut short & with a damaged index
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "FlockRecording.h"
+#include "Test.h"
+
+static const char* recordingPath = "flockcore_test_recording.bin";
+static const int perBoid = 4;
+
+// frame f has f + 1 boids, float k of it is f * 1000 + k
+static void writeRecording(int numFrames) {
+	FlockRecorder recorder;
+	CHECK(recorder.open(recordingPath, 2, perBoid));
+	for (int f = 0; f < numFrames; f++) {
+		RecordedFrame frame = {};
+		frame.numBoids = f + 1;
+		frame.time = f;
+		float* out = recorder.begin(frame);
+		for (int k = 0; k < (f + 1) * perBoid; k++) out[k] = f * 1000 + k;
+		recorder.submit();
+	}
+	recorder.close();
+	CHECK(recorder.framesDropped() == 0);
+}
+
+static std::vector<char> readFile() {
+	std::ifstream in(recordingPath, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::vector<char>& bytes) {
+	std::ofstream out(recordingPath, std::ios::binary | std::ios::trunc);
+	out.write(bytes.data(), bytes.size());
+}
+
+// every frame the recording has is the one written
+static void checkFrames(const FlockRecording& recording) {
+	for (int f = 0; f < recording.numFrames(); f++) {
+		CHECK(recording.frame(f).numBoids == (uint32_t)f + 1);
+		CHECK(recording.frame(f).time == f);
+		const float* boids = recording.boids(f);
+		CHECK(boids[0] == f * 1000);
+		CHECK(boids[(f + 1) * perBoid - 1] == f * 1000 + (f + 1) * perBoid - 1);
+	}
+}
+
+TEST(recordingRoundTrip) {
+	writeRecording(20);
+
+	FlockRecording recording;
+	CHECK(recording.open(recordingPath));
+	CHECK(recording.dims() == 2);
+	CHECK(recording.floatsPerBoid() == perBoid);
+	CHECK(recording.numFrames() == 20);
+	checkFrames(recording);
+	recording.close();
+
+	std::remove(recordingPath);
+}
+
+// a crash mid recording leaves no index & half a frame, the whole frames before it are kept
+TEST(recordingCutShort) {
+	writeRecording(20);
+	std::vector<char> bytes = readFile();
+
+	// frames 0-9 take header + 10 frame headers + 55 boids
+	size_t tenFrames = sizeof(RecordingHeader) + 10 * sizeof(RecordedFrame) + 55 * perBoid * sizeof(float);
+	bytes.resize(tenFrames + sizeof(RecordedFrame) + 3);
+	writeFile(bytes);
+
+	FlockRecording recording;
+	CHECK(recording.open(recordingPath));
+	CHECK(recording.numFrames() == 10);
+	checkFrames(recording);
+	recording.close();
+
+	std::remove(recordingPath);
+}
+
+// an index pointing past the frames is not trusted, the frames are walked instead
+TEST(recordingDamagedIndex) {
+	writeRecording(5);
+	std::vector<char> bytes = readFile();
+
+	RecordingFooter footer;
+	memcpy(&footer, bytes.data() + bytes.size() - sizeof(footer), sizeof(footer));
+	uint64_t bad = bytes.size() * 2;
+	memcpy(bytes.data() + footer.indexOffset + 3 * sizeof(uint64_t), &bad, sizeof(bad));
+	writeFile(bytes);
+
+	FlockRecording recording;
+	CHECK(recording.open(recordingPath));
+	CHECK(recording.numFrames() >= 5);
+	for (int f = 0; f < 5 && f < recording.numFrames(); f++) CHECK(recording.frame(f).numBoids == (uint32_t)f + 1);
+	recording.close();
+
+	// & a footer whose index offset is past the end of the file
+	footer.indexOffset = ~0ull;
+	memcpy(bytes.data() + bytes.size() - sizeof(footer), &footer, sizeof(footer));
+	writeFile(bytes);
+	CHECK(recording.open(recordingPath));
+	CHECK(recording.numFrames() >= 5);
+	recording.close();
+
+	std::remove(recordingPath);
+}
+
+TEST(recordingWrongMagic) {
+	writeRecording(3);
+	std::vector<char> bytes = readFile();
+	bytes[0] = 'X';
+	writeFile(bytes);
+
+	FlockRecording recording;
+	CHECK(!recording.open(recordingPath));
+	CHECK(!recording.isOpen());
+
+	std::remove(recordingPath);
+}
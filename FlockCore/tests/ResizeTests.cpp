@@ -0,0 +1,47 @@
+// growing & shrinking the flock a few boids at a time, as dragging the # of Boids slider does
+
+#include "Simulation2D.h"
+#include "Simulation3D.h"
+#include "Test.h"
+
+// once grown past its first capacity, the flock grows a few boids at a time without moving its arrays
+template <typename Sim>
+static void checkSmallGrows(Sim& sim) {
+	sim.createFlock(100);
+	sim.resize(101);
+	int capacity = sim.flock.capacity();
+	CHECK(capacity >= 200);
+
+	const glm::vec3* position = sim.flock.position.data();
+	const glm::vec3* velocity = sim.flock.velocity.data();
+	const glm::vec3* force = sim.flock.force.data();
+
+	for (int n = 104; n <= capacity; n += 3) {
+		sim.resize(n);
+		CHECK(sim.flock.size() == n);
+		CHECK(sim.flock.capacity() == capacity);
+		CHECK(sim.flock.position.data() == position);
+		CHECK(sim.flock.velocity.data() == velocity);
+		CHECK(sim.flock.force.data() == force);
+	}
+
+	// shrinking & growing back keeps them too
+	sim.resize(50);
+	sim.resize(capacity);
+	CHECK(sim.flock.capacity() == capacity);
+	CHECK(sim.flock.position.data() == position);
+
+	// & past the capacity it at least doubles
+	sim.resize(capacity + 1);
+	CHECK(sim.flock.capacity() >= 2 * capacity);
+}
+
+TEST(resize2DGrowsGeometrically) {
+	Simulation2D sim(1, 7);
+	checkSmallGrows(sim);
+}
+
+TEST(resize3DGrowsGeometrically) {
+	Simulation3D sim(1, 7);
+	checkSmallGrows(sim);
+}
@@ -0,0 +1,73 @@
+// spatial hash queries against a brute force search, near the origin & far out in an unbounded world
+
+#include <climits>
+#include <random>
+
+#include "SpatialHash.h"
+#include "Test.h"
+
+// boids spread around center, a third of them on top of another boid
+static std::vector<glm::vec3> randomFlock(int n, glm::vec3 center, float spread, std::mt19937& rng) {
+	std::uniform_real_distribution<float> u(-spread, spread);
+	std::vector<glm::vec3> positions(n);
+	for (int i = 0; i < n; i++) {
+		positions[i] = center + glm::vec3(u(rng), u(rng), u(rng));
+		if (i > 0 && i % 3 == 0) positions[i] = positions[rng() % i];
+	}
+	return positions;
+}
+
+// every boid within radius of p is visited exactly once, & no boid is visited twice
+static void checkQuery(const SpatialHash& hash, const std::vector<glm::vec3>& positions, glm::vec3 p, float radius) {
+	std::vector<int> visits(positions.size(), 0);
+	hash.query(p, radius, [&](int i) { visits[i]++; });
+
+	for (int i = 0; i < (int)positions.size(); i++) {
+		CHECK(visits[i] <= 1);
+		if (glm::length(positions[i] - p) < radius) CHECK(visits[i] == 1);
+	}
+}
+
+static void checkFlock(glm::vec3 center, float spread, float radius) {
+	std::mt19937 rng(1);
+	for (int n : { 1, 40, 700 }) {
+		std::vector<glm::vec3> positions = randomFlock(n, center, spread, rng);
+		SpatialHash hash;
+		hash.build(positions, radius);
+
+		for (glm::vec3 p : positions) checkQuery(hash, positions, p, radius);
+		checkQuery(hash, positions, center, radius * 2.5f);
+	}
+}
+
+TEST(spatialHashMatchesBruteForce) {
+	checkFlock(glm::vec3(0, 0, 0), 60, 10);
+	checkFlock(glm::vec3(-5000, 20, -7000), 60, 10);
+	checkFlock(glm::vec3(1e6f, -1e6f, 1e6f), 100, 7);
+}
+
+// cells past INT_MAX, where float positions are coarser than a cell, & past the clamp
+TEST(spatialHashFarOut) {
+	checkFlock(glm::vec3(1e12f, -1e12f, 3e11f), 1e8f, 1e6f);
+	checkFlock(glm::vec3(1e12f, -1e12f, 3e11f), 1e6f, 10);
+	checkFlock(glm::vec3(-1e12f, 1e12f, -1e12f), 1e6f, 10);
+	checkFlock(glm::vec3(3e38f, -3e38f, 1e30f), 1e30f, 10);
+}
+
+TEST(spatialHashCells) {
+	SpatialHash hash;
+	hash.build({ glm::vec3(0, 0, 0) }, 10);
+
+	glm::vec3 p(1e12f, -1e12f, -0.5f);
+	SpatialHash::Cell c = hash.cell(p);
+	CHECK(c.x == (int64_t)std::floor((double)p.x / 10));
+	CHECK(c.y == (int64_t)std::floor((double)p.y / 10));
+	CHECK(c.z == -1);
+	CHECK(c.x > INT_MAX);
+	CHECK(c.y < INT_MIN);
+
+	c = hash.cell(glm::vec3(3e38f, -3e38f, INFINITY));
+	CHECK(c.x == (int64_t)1 << 60);
+	CHECK(c.y == -((int64_t)1 << 60));
+	CHECK(c.z == (int64_t)1 << 60);
+}
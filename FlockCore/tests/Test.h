@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// minimal test registry for flockcore_tests
+// TEST(name) { ... } defines & registers a test, CHECK & CHECK_NEAR record failures & carry on
+struct TestCase {
+	const char* name;
+	void (*run)();
+};
+
+std::vector<TestCase>& testCases();
+void testFailed(const char* file, int line, const char* what);
+
+struct TestRegistrar {
+	TestRegistrar(const char* name, void (*run)()) { testCases().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) testFailed(__FILE__, __LINE__, #cond); \
+	} while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { \
+		double a_ = (a), b_ = (b); \
+		if (!(std::abs(a_ - b_) <= (tolerance))) { \
+			char what_[256]; \
+			snprintf(what_, sizeof(what_), "%s = %g, %s = %g", #a, a_, #b, b_); \
+			testFailed(__FILE__, __LINE__, what_); \
+		} \
+	} while (0)
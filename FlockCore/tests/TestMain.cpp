@@ -0,0 +1,36 @@
+// flockcore_tests: runs every registered test, or those whose name contains the first argument
+// exits non-zero if any check failed
+
+#include <cstring>
+
+#include "Test.h"
+
+static int failures = 0;
+
+std::vector<TestCase>& testCases() {
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void testFailed(const char* file, int line, const char* what) {
+	printf("  %s:%d: %s\n", file, line, what);
+	failures++;
+}
+
+int main(int argc, char** argv) {
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	int run = 0, failed = 0;
+	for (const TestCase& t : testCases()) {
+		if (!strstr(t.name, filter)) continue;
+
+		int before = failures;
+		t.run();
+		run++;
+		if (failures > before) failed++;
+		printf("%s %s\n", failures > before ? "FAIL" : "ok  ", t.name);
+	}
+
+	printf("%d of %d tests passed\n", run - failed, run);
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+#include "BatchedFlock.h"
+
+//--------------------------------------------------------------
+void BatchedFlock::setup(const vector<glm::vec3>& triangle, glm::vec3 header, ofColor boidColor, ofColor headerColor) {
+	boid = triangle;
+	boidColors.assign(triangle.size(), boidColor);
+
+	// header line as a one unit wide quad from the boid center to header, under the triangle
+	glm::vec3 side = glm::normalize(glm::cross(header, glm::vec3(0, 0, 1))) * 0.5f;
+	boidWithHeader = { -side, side, header + side, -side, header + side, header - side };
+	boidWithHeader.insert(boidWithHeader.end(), boid.begin(), boid.end());
+	boidWithHeaderColors.assign(6, headerColor);
+	boidWithHeaderColors.insert(boidWithHeaderColors.end(), boidColors.begin(), boidColors.end());
+
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	mesh.setUsage(GL_STREAM_DRAW);
+	mesh.clear();
+}
+
+//--------------------------------------------------------------
+void BatchedFlock::update(const Flock2D& flock, bool showHeaders, ThreadPool& threadPool) {
+	const vector<glm::vec3>& shape = showHeaders ? boidWithHeader : boid;
+	const vector<ofFloatColor>& shapeColors = showHeaders ? boidWithHeaderColors : boidColors;
+	int perBoid = shape.size();
+	size_t numVertices = (size_t)flock.size() * perBoid;
+
+	// colors only change with the flock size or the header toggle
+	vector<glm::vec3>& vertices = mesh.getVertices();
+	if (vertices.size() != numVertices || showHeaders != headers) {
+		headers = showHeaders;
+		vertices.resize(numVertices);
+
+		vector<ofFloatColor>& colors = mesh.getColors();
+		colors.resize(numVertices);
+		for (size_t v = 0; v < numVertices; v++) colors[v] = shapeColors[v % perBoid];
+	}
+
+	// boid space to window, the flock is 2D so only the x, y columns & translation matter
+	glm::vec3* out = vertices.data();
+	threadPool.parallelFor(flock.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			const glm::mat4& T = flock.getTransform(i);
+			glm::vec3 x = glm::vec3(T[0]), y = glm::vec3(T[1]), p = glm::vec3(T[3]);
+
+			glm::vec3* v = out + (size_t)i * perBoid;
+			for (int k = 0; k < perBoid; k++) v[k] = p + x * shape[k].x + y * shape[k].y;
+		}
+	});
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Simulation2D.h"
+
+// draws the whole 2D flock as one triangle mesh in a single draw call
+// boid triangles & header lines are transformed on the cpu into a vbo mesh that is refilled in place
+class BatchedFlock {
+public:
+	// boid triangle, header line end & colors, in boid space
+	void setup(const vector<glm::vec3>& triangle, glm::vec3 header, ofColor boidColor, ofColor headerColor);
+
+	// transform every boid into the mesh, once per frame before draw
+	void update(const Flock2D& flock, bool showHeaders, ThreadPool& threadPool);
+
+	void draw() { mesh.draw(); }
+
+private:
+	// vertices & colors of one boid, without & with header
+	vector<glm::vec3> boid, boidWithHeader;
+	vector<ofFloatColor> boidColors, boidWithHeaderColors;
+
+	ofVboMesh mesh;
+	bool headers = false;
+};
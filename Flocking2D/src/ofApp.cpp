@@ -1,23 +1,6 @@
 #include "ofApp.h"
 
 
-void Boid::turnBoid(glm::vec3 p) {
-	ofApp* theApp = (ofApp*)ofGetAppPtr();
-
-	// find angle between heading & target point
-	glm::vec3 h = heading();
-	glm::vec3 v = glm::normalize(p - position);
-	float dotProduct = glm::dot(h, v);
-	float eps = 0.3;
-
-	if (dotProduct < (1.0 - eps)) {
-		// turn clockwise/counterclockwise depending on axis of rotation
-		glm::vec3 crossProduct = glm::cross(h, v);
-		angularForce = theApp->turnSpeed;
-		angularForce *= (crossProduct.z > 0) ? 1 : -1;
-	}
-}
-
 //--------------------------------------------------------------
 void ofApp::setup() {
 	ofSetBackgroundColor(ofColor::lightGray);
@@ -30,12 +13,21 @@ void ofApp::setup() {
 	gui.add(sep.set("Separation", true));
 	gui.add(coh.set("Cohesion", true));
 	gui.add(ali.set("Alignment", true));
+	gui.add(multithreaded.set("Multithreaded Update (M)", false));
+	gui.add(simThreaded.set("Simulation Thread (J)", true));
+	gui.add(simd.set("SIMD Rules (V)", false));
+	gui.add(fixedTimestep.set("Fixed Timestep (X)", false));
+	gui.add(topological.set("Topological kNN (N)", false));
+	gui.add(neighborLists.set("Neighbor Lists (E)", false));
+	gui.add(batched.set("Batched Drawing (B)", true));
 
 	flockSettings.setName("Flock Settings");
-	flockSettings.add(numBoids.set("# of Boids", 1, 1, 100));
+	flockSettings.add(numBoids.set("# of Boids", 1, 1, 100000));
 	flockSettings.add(scale.set("Boid Scale", 1, 1, 5));
 	flockSettings.add(neighborDistance.set("Neighbor Distance", 20, 10, 100));
 	flockSettings.add(separationValue.set("Desired Separation", 250, 100, 500));
+	flockSettings.add(numNearest.set("Nearest Neighbors (k)", 7, 1, 32));
+	flockSettings.add(skin.set("Neighbor List Skin", 10, 0, 50));
 	flockSettings.add(toggleHeader.set("Toggle Boid Headers", false));
 
 	movement.setName("Boid Movement");
@@ -49,244 +41,323 @@ void ofApp::setup() {
 	forces.add(maxTurbulence.set("Max Turbulence", glm::vec3(0, 0, 0), glm::vec3(-100, -100, -100),
 		glm::vec3(100, 100, 100)));
 
+	replaySettings.setName("Recording");
+	replaySettings.add(record.set("Record (C)", false));
+	replaySettings.add(replay.set("Replay (O)", false));
+	replaySettings.add(replaySpeed.set("Replay Speed", 1, -8, 8));
+	replaySettings.add(replayPosition.set("Replay Position", 0, 0, 1));
+
+	profiling.setName("Profiling");
+	profiling.add(profileHud.set("Profiler HUD (G)", false));
+	profiling.add(profileCsv.set("Write Profile CSV", false));
+
 	gui.add(flockSettings);
 	gui.add(movement);
 	gui.add(forces);
+	gui.add(replaySettings);
+	gui.add(profiling);
 
 
-	// flock setup
-	createFlock();
+	// boid triangle
+	verts.push_back(glm::vec3(-10, 15, 0));
+	verts.push_back(glm::vec3(10, 15, 0));
+	verts.push_back(glm::vec3(0, -15, 0));
+	batchedFlock.setup(verts, header, ofColor::black, ofColor::red);
 
 
-	// target point
-	targetPoint = glm::vec3(ofGetWindowWidth() / 2, ofGetWindowHeight() / 2, 0);
-}
+	// flock setup, carries on from the last checkpoint if there is one
+	syncParams();
+	if (!loadCheckpoint()) sim.createFlock(numBoids);
 
-// create new flock
-void ofApp::createFlock() {
-	flock.clear();
-	float w = ofGetWindowWidth();
-	float h = ofGetWindowHeight();
 
-	for (int i = 0; i < numBoids; i++) {
-		createBoid(w, h);
-	}
+	// target point
+	sim.targetPoint = glm::vec3(ofGetWindowWidth() / 2, ofGetWindowHeight() / 2, 0);
 }
 
-// create random new boid within bounds of window
-void ofApp::createBoid(float w, float h) {
-	Boid* b = new Boid(glm::vec3(ofRandom(0, w), ofRandom(0, h), 0));
-	b->rotation = ofRandom(0, 359);
-	b->scale = glm::vec3(scale, scale, scale);
-
-	// initial speed
-	b->force = b->heading() * ofRandom(minSpeed, maxSpeed) * 100;
-
-	flock.push_back(b);
+// copy gui settings & window bounds into the simulation
+void ofApp::syncParams() {
+	FlockParams2D& p = params;
+	p.startSim = startSim;
+	p.targetMode = targetMode;
+	p.sep = sep;
+	p.coh = coh;
+	p.ali = ali;
+	p.multithreaded = multithreaded;
+	p.simd = simd;
+	p.fixedTimestep = fixedTimestep;
+	p.topological = topological;
+	p.numNearest = numNearest;
+	p.neighborLists = neighborLists;
+	p.skin = skin;
+
+	p.scale = scale;
+	p.neighborDistance = neighborDistance;
+	p.separationValue = separationValue;
+
+	p.minSpeed = minSpeed;
+	p.maxSpeed = maxSpeed;
+	p.turnSpeed = turnSpeed;
+
+	// a posted command allocates, so only post when something changed
+	float width = ofGetWindowWidth();
+	float height = ofGetWindowHeight();
+	if (width == postedWidth && height == postedHeight && p == postedParams) return;
+	postedParams = p;
+	postedWidth = width;
+	postedHeight = height;
+
+	apply([p, width, height](Simulation2D& s) {
+		s.params = p;
+		s.width = width;
+		s.height = height;
+	});
 }
 
-// push boid away from neighbors NEEDS FIXING
-glm::vec3 ofApp::separate(Boid* boid, int index) {
-	glm::vec3 direction = glm::vec3(0, 0, 0);
-	float numNeighbors = 0;
-
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
-
-		// determine if b is a neighbor
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist > 0) && (dist < separationValue)) {
+// copy the simulation's settings back into the gui, so the next syncParams keeps them
+void ofApp::restoreParams() {
+	const FlockParams2D& p = sim.params;
+	startSim = p.startSim;
+	targetMode = p.targetMode;
+	sep = p.sep;
+	coh = p.coh;
+	ali = p.ali;
+	multithreaded = p.multithreaded;
+	simd = p.simd;
+	fixedTimestep = p.fixedTimestep;
+	topological = p.topological;
+	numNearest = p.numNearest;
+	neighborLists = p.neighborLists;
+	skin = p.skin;
+
+	scale = p.scale;
+	neighborDistance = p.neighborDistance;
+	separationValue = p.separationValue;
+
+	minSpeed = p.minSpeed;
+	maxSpeed = p.maxSpeed;
+	turnSpeed = p.turnSpeed;
+	params = p;
+}
 
-			// find direction from neighbor to boid
-			glm::vec3 diff = glm::normalize(boid->position - b->position);
+// step the simulation on its own thread when the toggle is on, in update() while replaying
+void ofApp::updateSimThread() {
+	bool threaded = simThreaded && !replay;
 
-			direction += diff / dist;
-			numNeighbors++;
-		}
+	if (threaded && !simThread.isRunning()) {
+		simThread.start(sim, [this](Simulation2D& s, float dt) {
+			s.update(dt);
+			if (recorder.isOpen()) s.record(recorder); // only opened & closed while the thread is stopped
+		});
 	}
+	else if (!threaded && simThread.isRunning()) simThread.stop();
+}
 
-	if (numNeighbors > 0) {
-		direction /= numNeighbors; // avg direction to neighbors
+// run command on the simulation: queued for the sim thread while it runs, right away otherwise
+void ofApp::apply(std::function<void(Simulation2D&)> command) {
+	if (simThread.isRunning()) simThread.post(std::move(command));
+	else command(sim);
+}
 
-		// return difference between desired pos and current pos
-		return direction;
+// save the simulation & gui settings to the data folder
+void ofApp::saveCheckpoint() {
+	simThread.stop();
+	if (sim.save(ofToDataPath("checkpoint.bin", true)) && gui.saveToFile("checkpoint.xml")) {
+		cout << "saved checkpoint of " << sim.flock.size() << " boids" << endl;
 	}
-
-	return direction; // 0, 0, 0
 }
 
-// find center of a neighborhood of boids and push them towards it
-glm::vec3 ofApp::cohesion(Boid* boid, int index) {
-	glm::vec3 avgPosition = glm::vec3(0, 0, 0);
-	float numNeighbors = 0;
-
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
-
-		// determine if b is a neighbor
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist > 0) && (dist < neighborDistance)) {
-			avgPosition += b->position;
-			numNeighbors++;
-		}
-	}
+// restore the last saved checkpoint, false if there's none
+bool ofApp::loadCheckpoint() {
+	simThread.stop();
+	if (!ofFile::doesFileExist("checkpoint.bin") || !sim.load(ofToDataPath("checkpoint.bin", true))) return false;
+
+	// the gui file has the settings that aren't simulation params, the checkpoint has the rest
+	gui.loadFromFile("checkpoint.xml");
+	restoreParams();
+	numBoids = sim.flock.size();
+	postedWidth = -1; // the checkpoint's world size is replaced by the window's
+	record = false;
+	replay = false;
+	return true;
+}
 
-	if (numNeighbors > 0) {
-		avgPosition /= numNeighbors;
+// time frames while the hud or the csv export is on
+void ofApp::updateProfiler() {
+	Profiler& profiler = sim.profiler;
+	profiler.enabled = profileHud || profileCsv;
 
-		// return difference between desired pos and current pos
-		return avgPosition - boid->position;
+	if (profileCsv && !profiler.isWritingCsv()) {
+		string path = ofToDataPath("profile-" + ofGetTimestampString() + ".csv", true);
+		if (!profiler.openCsv(path)) profileCsv = false;
 	}
-
-	return avgPosition; // 0, 0, 0
+	else if (!profileCsv && profiler.isWritingCsv()) profiler.closeCsv();
 }
 
-// get difference between boid velocity & average velocity of neighbors
-glm::vec3 ofApp::align(Boid* boid, int index) {
-	glm::vec3 avgHeading = glm::vec3(0, 0, 0);
-	float avgSpeed = 0;
-	float numNeighbors = 0;
-
-	// get velocity of neighboring boids
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
-
-		// determine if b is a neighbor
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist > 0) && (dist < neighborDistance)) {
-			avgHeading += b->heading();
-			avgSpeed = glm::length(b->velocity);
-			numNeighbors++;
-		}
-	}
-
-	if (numNeighbors > 0) {
-		// get average velocity of neighbors
-		avgHeading /= numNeighbors;
-		avgSpeed /= numNeighbors;
-
-		// cap boid velocity
-		if (abs(glm::length(boid->velocity)) > maxSpeed) avgSpeed = 0;
+// start/stop recording & replay when their toggles change
+void ofApp::updateRecording() {
+	if (replay) record = false; // replays aren't recorded again
 
-		glm::vec3 alignForce = avgHeading * avgSpeed;
+	// the recorder is only opened & closed while the sim thread is stopped, it's restarted in updateSimThread()
+	if (record != recorder.isOpen()) simThread.stop();
 
-		return alignForce;
+	if (record && !recorder.isOpen()) {
+		recordingPath = ofToDataPath("flock-" + ofGetTimestampString() + ".flock", true);
+		if (!recorder.open(recordingPath, 2, Simulation2D::recordedFloats)) record = false;
+	}
+	else if (!record && recorder.isOpen()) {
+		recorder.close();
+		cout << "recorded " << recorder.framesWritten() << " frames to " << recordingPath << endl;
 	}
 
-	return avgHeading; // 0, 0, 0
+	if (replay && !recording.isOpen()) {
+		if (!recording.open(recordingPath) || recording.dims() != 2 || recording.numFrames() == 0) {
+			recording.close();
+			replay = false;
+		}
+		replayPosition = 0;
+	}
+	else if (!replay && recording.isOpen()) recording.close();
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
-	float width = ofGetWindowWidth();
-	float height = ofGetWindowHeight();
+	updateRecording();
+	updateSimThread();
+	syncParams();
+	updateProfiler();
+
+	if (replay) {
+		// show a recorded frame instead of simulating, plays while the simulation is started
+		float last = recording.numFrames() - 1;
+		float frame = replayPosition * last;
+		if (startSim && last > 0) frame = ofWrap(frame + replaySpeed, 0, last);
+		replayPosition = last > 0 ? frame / last : 0;
+
+		sim.replay(recording, std::round(frame));
+		postedBoids = -1; // the recorded flock size is replaced by the slider's after the replay
+	}
+	else {
+		// update flock size based on numBoids slider
+		int n = numBoids;
+		if (n != postedBoids) {
+			postedBoids = n;
+			apply([n](Simulation2D& s) { s.resize(n); });
+		}
 
-	// update flock size based on numBoids slider
-	if (numBoids < flock.size()) {
+		// update all boids in the flock, unless the sim thread does
+		// fixed timestep mode steps by the real time that passed, in constant dt substeps
+		if (!simThread.isRunning()) {
+			if (fixedTimestep) sim.update(ofGetLastFrameTime());
+			else sim.update(1.0 / ofGetFrameRate());
 
-		// decrease flock size
-		int diff = flock.size() - numBoids;
-		for (int i = 0; i < diff; i++) {
-			flock.pop_back();
+			if (record) sim.record(recorder);
 		}
 	}
-	else if (numBoids > flock.size()) {
 
-		// increase flock size
-		int diff = numBoids - flock.size();
-		for (int i = 0; i < diff; i++) {
-			createBoid(width, height);
-		}
+	// the sim thread's newest frame, never waits for a step in progress
+	if (simThread.isRunning()) drawn = &simThread.latest();
+	else {
+		sim.snapshot(stepped);
+		drawn = &stepped;
 	}
 
+	// refill the flock mesh for the batched draw
+	if (batched) batchedFlock.update(drawn->flock, toggleHeader, drawThreads);
+}
+
+//--------------------------------------------------------------
+void ofApp::draw() {
 
-	// update all boids in the flock
-	//glm::vec3 minT = minTurbulence.get() * 10;
-	//glm::vec3 maxT = maxTurbulence.get() * 10;
-	for (int i = 0; i < flock.size(); i++) {
+	if (targetMode) {
+		ofSetColor(ofColor::orange);
+		ofDrawCircle(drawn->targetPoint, 10);
+	}
 
-		Boid* b = flock[i];
-		b->scale = glm::vec3(scale, scale, scale);
-		b->bToggleHeader = toggleHeader;
+	// draw flock
+	{
+		ProfileScope scope(sim.profiler, profile::DrawFlock);
 
+		const Flock2D& flock = drawn->flock;
+		if (batched) batchedFlock.draw();
+		else for (int i = 0; i < flock.size(); i++) {
+			ofPushMatrix();
+			ofMultMatrix(flock.getTransform(i));
 
-		// target mode - test turn & movement
-		if (targetMode) {
-			b->turnBoid(targetPoint);
+			if (toggleHeader) { // show boid direction
+				ofSetColor(ofColor::red);
+				ofDrawLine(glm::vec3(0, 0, 0), header);
+			}
 
-			if (startSim) b->force = targetPoint - b->position;
-			else b->force = glm::vec3(0, 0, 0);
+			ofFill();
+			ofSetColor(ofColor::black);
+			ofDrawTriangle(verts[0], verts[1], verts[2]);
 
-			b->integrate();
-			continue;
+			ofPopMatrix();
 		}
+	}
 
+	// draw gui
+	if (!bHide) {
+		ProfileScope scope(sim.profiler, profile::DrawGui);
+		gui.draw();
+	}
 
-		// flocking simulation
-		if (startSim) {
+	if (profileHud) drawProfiler();
+	sim.profiler.endFrame();
+}
 
-			// turbulence force
-			/*b->force = glm::vec3(ofRandom(minT.x, maxT.x), ofRandom(minT.y, maxT.y),
-				ofRandom(minT.z, maxT.z));*/
+// phase timings to the right of the gui
+void ofApp::drawProfiler() {
+	glm::vec3 p = gui.getPosition();
+	float x = bHide ? p.x : p.x + gui.getWidth() + 10;
+	string report = sim.profiler.report();
+	report += "simd kernels " + string(kernels::name(sim.simdLevel)) + "\n";
+	if (neighborLists) {
+		report += "lists rebuilt " + ofToString(sim.neighborList.rebuilds.load()) +
+			" of " + ofToString(sim.neighborList.steps.load()) + " steps\n";
+	}
+	ofDrawBitmapStringHighlight(report, x, p.y + 20);
+}
 
-				// separation: keep boid a certain distance from neighbors
-			if (sep) b->force += separate(b, i);
+//--------------------------------------------------------------
+void ofApp::keyPressed(int key) {
+	keymap[key] = true;
 
-			// cohesion: keep boid a certain distance within neighbors
-			if (coh) b->force += cohesion(b, i);
+	if (keymap['h'] || keymap['H']) bHide = !bHide;
 
-			// alignment: match boid speed with neighbor's speeds
-			if (ali) b->force += align(b, i);
+	if (keymap['s'] || keymap['S']) startSim = !startSim;
 
-			// turn boid towards direction its moving
-			b->turnBoid(b->position + b->velocity);
+	// reset flock
+	if (keymap['r'] || keymap['R']) {
+		int n = numBoids;
+		apply([n](Simulation2D& s) { s.createFlock(n); });
+	}
 
-			// integrate
-			b->integrate();
+	if (keymap['t'] || keymap['T']) targetMode = !targetMode;
 
+	if (keymap['m'] || keymap['M']) multithreaded = !multithreaded;
 
-			// wrap around edges of window
-			if (b->position.x < 0) b->position.x += width;
-			else if (b->position.x > width) b->position.x -= width;
+	if (keymap['j'] || keymap['J']) simThreaded = !simThreaded;
 
-			if (b->position.y < 0) b->position.y += height;
-			else if (b->position.y > height) b->position.y -= height;
-		}
-	}
-}
+	if (keymap['v'] || keymap['V']) simd = !simd;
 
-//--------------------------------------------------------------
-void ofApp::draw() {
+	if (keymap['x'] || keymap['X']) fixedTimestep = !fixedTimestep;
 
-	if (targetMode) {
-		ofSetColor(ofColor::orange);
-		ofDrawCircle(targetPoint, 10);
-	}
+	if (keymap['n'] || keymap['N']) topological = !topological;
 
-	// draw flock
-	for (Boid* b : flock) {
-		b->draw();
-	}
+	if (keymap['e'] || keymap['E']) neighborLists = !neighborLists;
 
-	// draw gui
-	if (!bHide) gui.draw();
-}
+	if (keymap['b'] || keymap['B']) batched = !batched;
 
-//--------------------------------------------------------------
-void ofApp::keyPressed(int key) {
-	keymap[key] = true;
+	if (keymap['c'] || keymap['C']) record = !record;
 
-	if (keymap['h'] || keymap['H']) bHide = !bHide;
+	if (keymap['o'] || keymap['O']) replay = !replay;
 
-	if (keymap['s'] || keymap['S']) startSim = !startSim;
+	if (keymap[OF_KEY_F5]) saveCheckpoint();
 
-	// reset flock
-	if (keymap['r'] || keymap['R']) createFlock();
+	if (keymap[OF_KEY_F9]) loadCheckpoint();
 
-	if (keymap['t'] || keymap['T']) targetMode = !targetMode;
+	if (keymap['g'] || keymap['G']) profileHud = !profileHud;
 }
 
 //--------------------------------------------------------------
@@ -306,7 +377,7 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
 //--------------------------------------------------------------
 void ofApp::mousePressed(int x, int y, int button) {
-	if (targetMode) targetPoint = glm::vec3(x, y, 0);
+	if (targetMode) apply([x, y](Simulation2D& s) { s.targetPoint = glm::vec3(x, y, 0); });
 }
 
 //--------------------------------------------------------------
@@ -314,11 +385,9 @@ void ofApp::mouseReleased(int x, int y, int button) {
 	if (!targetMode) {
 
 		// add new boid at mouse position
-		Boid* b = new Boid(glm::vec3(x, y, 0));
-		b->rotation = ofRandom(0, 359);
-		b->scale = glm::vec3(scale, scale, scale);
+		float r = ofRandom(0, 359);
+		apply([x, y, r](Simulation2D& s) { s.flock.add(glm::vec3(x, y, 0), r); });
 
-		flock.push_back(b);
 		numBoids++; // update slider
 	}
 }
@@ -345,5 +414,9 @@ void ofApp::gotMessage(ofMessage msg) {
 
 //--------------------------------------------------------------
 void ofApp::dragEvent(ofDragInfo dragInfo) {
-
+	// replay a recording dropped on the window
+	if (dragInfo.files.empty()) return;
+	recordingPath = dragInfo.files[0];
+	recording.close();
+	replay = true;
 }
@@ -2,114 +2,11 @@
 
 #include "ofMain.h"
 #include "ofxGui.h"
+#include "Simulation2D.h"
+#include "SimThread.h"
+#include "BatchedFlock.h"
 #include <glm/gtx/intersect.hpp>
 
-class Boid {
-public:
-	Boid() {
-		position = glm::vec3(0, 0, 0);
-		verts.push_back(glm::vec3(-10, 15, 0));
-		verts.push_back(glm::vec3(10, 15, 0));
-		verts.push_back(glm::vec3(0, -15, 0));
-	}
-
-	Boid(glm::vec3 p) {
-		position = p;
-		verts.push_back(glm::vec3(-10, 15, 0));
-		verts.push_back(glm::vec3(10, 15, 0));
-		verts.push_back(glm::vec3(0, -15, 0));
-	}
-
-	// get boid's transformation matrix
-	glm::mat4 getTransform() {
-		glm::mat4 T = glm::translate(glm::mat4(1.0), position);
-		glm::mat4 R = glm::rotate(glm::mat4(1.0), glm::radians(rotation), glm::vec3(0, 0, 1));
-		glm::mat4 S = glm::scale(glm::mat4(1.0), scale);
-
-		return (T * R * S);
-	}
-
-	// get boid's heading direction
-	glm::vec3 heading() {
-		glm::mat4 rot = glm::rotate(glm::mat4(1.0), glm::radians(rotation), glm::vec3(0, 0, 1));
-		return glm::normalize(rot * glm::vec4(0, -1, 0, 1));
-	}
-
-	void draw() {
-		ofPushMatrix();
-		ofMultMatrix(getTransform());
-
-		if (bToggleHeader) { // show boid direction
-			ofSetColor(ofColor::red);
-			ofDrawLine(glm::vec3(0, 0, 0), header);
-		}
-
-		ofFill();
-		ofSetColor(ofColor::black);
-		ofDrawTriangle(verts[0], verts[1], verts[2]);
-
-		ofPopMatrix();
-	}
-
-	void integrate() {
-		// calculate time interval
-		float dt = 1.0 / ofGetFrameRate();
-
-		// update position from velocity & time interval
-		position += heading() * glm::length(velocity) * dt;
-
-		// update velocity (from acceleration)
-		glm::vec3 accel = acceleration;
-		accel += (force * 1.0 / mass);
-		velocity += accel * dt;
-
-		// update rotation from angular velocity & time
-		rotation += angularVelocity * dt;
-
-		// update angular velocity (from angular acceleration)
-		float angAccel = angularAcceleration;
-		angAccel += angularForce / mass;
-		angularVelocity += angAccel * dt;
-
-		// multiply final result by the damping factor to sim drag
-		//velocity *= damping;
-		angularVelocity *= angularDamping;
-
-		// reset all forces
-		force = glm::vec3(0, 0, 0);
-		angularVelocity *= angularDamping;
-
-		// reset all forces
-		force = glm::vec3(0, 0, 0);
-		angularForce = 0;
-	}
-
-	void turnBoid(glm::vec3 p);
-
-	// boid physical traits
-	glm::vec3 position;
-	glm::vec3 header = glm::vec3(0, -30, 0);
-	vector<glm::vec3> verts; // vertices of the boid triangle
-	glm::vec3 scale = glm::vec3(1, 1, 1);
-	float mass = 1.0; // placeholder
-
-	// 3d motion
-	glm::vec3 velocity = glm::vec3(0, 0, 0);
-	glm::vec3 acceleration = glm::vec3(0, 0, 0);
-	glm::vec3 force = glm::vec3(0, 0, 0);
-	float damping = 0.99;
-
-	// angular motion
-	float rotation = 0.0;
-	float angularVelocity = 0;
-	float angularAcceleration = 0;
-	float angularForce = 0;
-	float angularDamping = .95;
-
-	bool bToggleHeader = false;
-};
-
-
 class ofApp : public ofBaseApp {
 public:
 	void setup();
@@ -128,17 +25,41 @@ public:
 	void dragEvent(ofDragInfo dragInfo);
 	void gotMessage(ofMessage msg);
 
-	void createFlock();
-	void createBoid(float w, float h);
-
-	glm::vec3 separate(Boid* boid, int index);
-	glm::vec3 cohesion(Boid* boid, int index);
-	glm::vec3 align(Boid* boid, int index);
+	void syncParams();
+	void restoreParams();
+	void updateSimThread();
+	void apply(std::function<void(Simulation2D&)> command);
+	void updateRecording();
+	void saveCheckpoint();
+	bool loadCheckpoint();
+	void updateProfiler();
+	void drawProfiler();
 
 	map<int, bool> keymap;
-	vector<Boid*> flock;
+	Simulation2D sim; // flock & rules, independent of the window
 
-	glm::vec3 targetPoint = glm::vec3(0, 0, 0);
+	// boid drawing
+	vector<glm::vec3> verts; // vertices of the boid triangle
+	glm::vec3 header = glm::vec3(0, -30, 0);
+	BatchedFlock batchedFlock; // whole flock in one mesh & draw call
+
+	// recording & replay
+	FlockRecorder recorder;
+	FlockRecording recording;
+	string recordingPath; // last recording made or dropped on the window
+
+	// simulation thread, declared after everything its steps use so it stops first
+	SimThread<Simulation2D, Simulation2D::Frame> simThread;
+	FlockParams2D params; // gui settings, sent to sim when they change
+
+	// what was last sent to sim, so unchanged settings aren't posted again every frame
+	// postedWidth < 0 or postedBoids < 0 sends them on the next update
+	FlockParams2D postedParams;
+	float postedWidth = -1, postedHeight = -1;
+	int postedBoids = -1;
+	Simulation2D::Frame stepped; // sim copied out after stepping in update(), without the thread
+	const Simulation2D::Frame* drawn = nullptr; // what to draw this frame
+	ThreadPool drawThreads; // fills the batched mesh while sim's pool may be busy stepping
 
 
 	// gui
@@ -147,12 +68,21 @@ public:
 	ofParameter<bool> startSim;
 	ofParameter<bool> targetMode;
 	ofParameter<bool> sep, coh, ali;
+	ofParameter<bool> multithreaded;
+	ofParameter<bool> simThreaded;
+	ofParameter<bool> simd;
+	ofParameter<bool> fixedTimestep;
+	ofParameter<bool> topological;
+	ofParameter<bool> neighborLists;
+	ofParameter<bool> batched;
 
 	ofParameterGroup flockSettings;
 	ofParameter<int> numBoids;
 	ofParameter<float> scale;
 	ofParameter<float> neighborDistance;
 	ofParameter<float> separationValue;
+	ofParameter<int> numNearest;
+	ofParameter<float> skin;
 	ofParameter<bool> toggleHeader;
 
 	ofParameterGroup movement;
@@ -163,4 +93,11 @@ public:
 	ofParameterGroup forces;
 	ofParameter<glm::vec3> minTurbulence;
 	ofParameter<glm::vec3> maxTurbulence;
+
+	ofParameterGroup replaySettings;
+	ofParameter<bool> record, replay;
+	ofParameter<float> replaySpeed, replayPosition;
+
+	ofParameterGroup profiling;
+	ofParameter<bool> profileHud, profileCsv;
 };
@@ -0,0 +1,249 @@
+#include "FishModel.h"
+#include "MappedFile.h"
+#include <glm/gtc/type_ptr.hpp>
+
+// cache layout, every field 4 bytes so arrays can be read straight out of the mapping:
+//   header, then per frame: float matrix[16], uint32 numParts,
+//   then per part: float diffuse[4], ambient[4], uint32 numVertices, numNormals, numIndices,
+//   vec3 vertices[numVertices], vec3 normals[numNormals], uint32 indices[numIndices]
+struct FishCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numFrames;
+	float headerYOffset;
+	float modelRadius;
+	uint32_t sourceSize[16]; // obj file sizes, a change rebuilds the cache
+};
+
+static const uint32_t cacheVersion = 1;
+static const int maxFrames = 16;
+
+static uint32_t fileSize(const string& path) {
+	ofFile file(path);
+	return file.exists() ? (uint32_t)file.getSize() : 0;
+}
+
+//--------------------------------------------------------------
+FishModel::~FishModel() {
+	if (thread.joinable()) thread.join();
+}
+
+void FishModel::load(const string& base, int n, const string& cache) {
+	basePath = base;
+	cachePath = ofToDataPath(cache, true);
+	numFrames = std::min(n, maxFrames);
+	loaded = false;
+	decoded = false;
+
+	// decode the cache in the background, or load the obj files on the first update
+	cacheHit = false;
+	thread = std::thread([this]() {
+		cacheHit = readCache();
+		decoded = true;
+	});
+}
+
+//--------------------------------------------------------------
+bool FishModel::update() {
+	if (loaded || !decoded) return false;
+	thread.join();
+
+	// no usable cache, the model loader needs the gl thread so this one loads the obj files
+	if (!cacheHit) {
+		loadModels();
+		if (!data.empty() && !writeCache()) cout << "error writing " << cachePath << endl;
+	}
+
+	finish();
+	return true;
+}
+
+// turn the cpu side frames into meshes ready to draw
+void FishModel::finish() {
+	frames.clear();
+	boundingRadius = 0;
+	for (const FrameData& frame : data) {
+		frames.push_back(FishFrame());
+		frames.back().matrix = frame.matrix;
+
+		for (const PartData& part : frame.parts) {
+			for (const glm::vec3& v : part.vertices) {
+				boundingRadius = std::max(boundingRadius, glm::length(glm::vec3(frame.matrix * glm::vec4(v, 1))));
+			}
+
+			FishPart p;
+			p.mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+			p.mesh.addVertices(part.vertices);
+			p.mesh.addNormals(part.normals);
+			p.mesh.addIndices(part.indices);
+			p.material.setDiffuseColor(part.diffuse);
+			p.material.setAmbientColor(part.ambient);
+			frames.back().parts.push_back(p);
+		}
+	}
+
+	data.clear();
+	loaded = true;
+}
+
+//--------------------------------------------------------------
+void FishModel::loadModels() {
+	data.clear();
+
+	for (int i = 0; i < numFrames; ++i) {
+		ofxAssimpModelLoader model;
+		string path = basePath + to_string(i);
+
+		if (!model.loadModel(path + ".obj")) {
+			cout << "error loading " + path + ".obj" << endl;
+			continue;
+		}
+
+		// correct model position so that it's center is at 0, 0, 0
+		glm::vec3 minBound = model.getSceneMin();
+		glm::vec3 maxBound = model.getSceneMax();
+		glm::vec3 center = (minBound + maxBound) / 2;
+		headerYOffset = center.y / 2;
+
+		// determine max dimension of model
+		if (center.x > modelRadius) modelRadius = center.x;
+		if (center.y > modelRadius) modelRadius = center.y;
+		if (center.z > modelRadius) modelRadius = center.z;
+
+		model.setScaleNormalization(false);
+		model.setScale(0.5, -0.5, -0.5);
+
+		FrameData frame;
+		frame.matrix = model.getModelMatrix();
+		for (int m = 0; m < (int)model.getMeshCount(); m++) {
+			ofMesh mesh = model.getMesh(m);
+			ofMaterial material = model.getMaterialForMesh(m);
+
+			PartData part;
+			part.diffuse = material.getDiffuseColor();
+			part.ambient = material.getAmbientColor();
+			part.vertices = mesh.getVertices();
+			part.normals = mesh.getNormals();
+			part.indices = mesh.getIndices();
+			frame.parts.push_back(part);
+		}
+		data.push_back(frame);
+	}
+}
+
+//--------------------------------------------------------------
+// reads from the memory mapped cache, bounds checked
+class CacheReader {
+public:
+	CacheReader(const MappedFile& file) : p(file.data()), end(file.data() + file.size()) {}
+
+	template <typename T>
+	const T* read(size_t count = 1) {
+		size_t bytes = sizeof(T) * count;
+		if (!ok || (size_t)(end - p) < bytes) {
+			ok = false;
+			return nullptr;
+		}
+		const T* value = (const T*)p;
+		p += bytes;
+		return value;
+	}
+
+	size_t remaining() const { return ok ? end - p : 0; }
+
+	bool ok = true;
+
+private:
+	const char* p;
+	const char* end;
+};
+
+bool FishModel::readCache() {
+	MappedFile file;
+	if (!file.open(cachePath)) return false;
+
+	CacheReader in(file);
+	const FishCacheHeader* header = in.read<FishCacheHeader>();
+	if (!header || memcmp(header->magic, "FISH", 4) != 0 || header->version != cacheVersion ||
+		(int)header->numFrames != numFrames) return false;
+
+	for (int i = 0; i < numFrames; i++) {
+		if (header->sourceSize[i] != fileSize(ofToDataPath(basePath + to_string(i) + ".obj"))) return false;
+	}
+
+	vector<FrameData> frames(numFrames);
+	for (FrameData& frame : frames) {
+		const float* matrix = in.read<float>(16);
+		const uint32_t* numParts = in.read<uint32_t>();
+		if (!in.ok) return false;
+
+		// every part takes at least its colors & counts, so a damaged count can't make us allocate past the file
+		const size_t minPartSize = sizeof(float) * 8 + sizeof(uint32_t) * 3;
+		if (*numParts > in.remaining() / minPartSize) return false;
+
+		frame.matrix = glm::make_mat4(matrix);
+		frame.parts.resize(*numParts);
+
+		for (PartData& part : frame.parts) {
+			const float* diffuse = in.read<float>(4);
+			const float* ambient = in.read<float>(4);
+			const uint32_t* counts = in.read<uint32_t>(3);
+			if (!in.ok) return false;
+
+			const glm::vec3* vertices = in.read<glm::vec3>(counts[0]);
+			const glm::vec3* normals = in.read<glm::vec3>(counts[1]);
+			const uint32_t* indices = in.read<uint32_t>(counts[2]);
+			if (!in.ok) return false;
+
+			part.diffuse = ofFloatColor(diffuse[0], diffuse[1], diffuse[2], diffuse[3]);
+			part.ambient = ofFloatColor(ambient[0], ambient[1], ambient[2], ambient[3]);
+			part.vertices.assign(vertices, vertices + counts[0]);
+			part.normals.assign(normals, normals + counts[1]);
+			part.indices.assign(indices, indices + counts[2]);
+		}
+	}
+
+	headerYOffset = header->headerYOffset;
+	modelRadius = header->modelRadius;
+	data = std::move(frames);
+	return true;
+}
+
+//--------------------------------------------------------------
+bool FishModel::writeCache() const {
+	ofstream out(cachePath, ios::binary);
+	if (!out) return false;
+
+	auto write = [&](const void* p, size_t bytes) { out.write((const char*)p, bytes); };
+
+	FishCacheHeader header = {};
+	memcpy(header.magic, "FISH", 4);
+	header.version = cacheVersion;
+	header.numFrames = data.size();
+	header.headerYOffset = headerYOffset;
+	header.modelRadius = modelRadius;
+	for (int i = 0; i < numFrames; i++) {
+		header.sourceSize[i] = fileSize(ofToDataPath(basePath + to_string(i) + ".obj"));
+	}
+	write(&header, sizeof(header));
+
+	for (const FrameData& frame : data) {
+		uint32_t numParts = frame.parts.size();
+		write(&frame.matrix, sizeof(frame.matrix));
+		write(&numParts, sizeof(numParts));
+
+		for (const PartData& part : frame.parts) {
+			uint32_t counts[3] = { (uint32_t)part.vertices.size(), (uint32_t)part.normals.size(), (uint32_t)part.indices.size() };
+			vector<uint32_t> indices(part.indices.begin(), part.indices.end());
+
+			write(&part.diffuse, sizeof(float) * 4);
+			write(&part.ambient, sizeof(float) * 4);
+			write(counts, sizeof(counts));
+			write(part.vertices.data(), part.vertices.size() * sizeof(glm::vec3));
+			write(part.normals.data(), part.normals.size() * sizeof(glm::vec3));
+			write(indices.data(), indices.size() * sizeof(uint32_t));
+		}
+	}
+
+	return (bool)out;
+}
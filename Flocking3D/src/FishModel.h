@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include "ofMain.h"
+#include "ofxAssimpModelLoader.h"
+
+// one mesh of one animation frame
+struct FishPart {
+	ofVboMesh mesh;
+	ofMaterial material;
+};
+
+// one animation frame of the fish
+struct FishFrame {
+	glm::mat4 matrix; // the model's own scale & placement
+	vector<FishPart> parts;
+};
+
+// the fish animation frames, from geo/fish-N.obj or from a binary cache of them
+// the cache is built the first time the obj files are loaded & memory mapped after that,
+// decoding it runs on a background thread so the window comes up right away
+class FishModel {
+public:
+	~FishModel();
+
+	// start loading numFrames frames of basePath-N.obj
+	void load(const string& basePath, int numFrames, const string& cachePath);
+
+	// call every frame, returns true once, on the frame loading finishes
+	bool update();
+
+	bool isLoaded() const { return loaded; }
+
+	vector<FishFrame> frames;
+	float headerYOffset = 0;
+	float modelRadius = 0;
+	float boundingRadius = 0; // furthest vertex from the boid's origin over all frames, for culling
+
+private:
+	// frames as plain cpu data, what the cache holds
+	struct PartData {
+		ofFloatColor diffuse, ambient;
+		vector<glm::vec3> vertices, normals;
+		vector<ofIndexType> indices;
+	};
+	struct FrameData {
+		glm::mat4 matrix;
+		vector<PartData> parts;
+	};
+
+	bool readCache();
+	bool writeCache() const;
+	void loadModels();
+	void finish();
+
+	string basePath, cachePath;
+	int numFrames = 0;
+	vector<FrameData> data;
+
+	std::thread thread;
+	std::atomic<bool> decoded { false };
+	bool cacheHit = false;
+	bool loaded = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// camera view volume as 6 planes facing inwards, for culling boids before they're drawn
+struct Frustum {
+	Frustum() {}
+
+	// planes of a view-projection matrix (Gribb & Hartmann), in the space the matrix maps from
+	explicit Frustum(const glm::mat4& m) {
+		glm::vec4 row[4];
+		for (int i = 0; i < 4; i++) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+		planes[0] = row[3] + row[0]; // left
+		planes[1] = row[3] - row[0]; // right
+		planes[2] = row[3] + row[1]; // bottom
+		planes[3] = row[3] - row[1]; // top
+		planes[4] = row[3] + row[2]; // near
+		planes[5] = row[3] - row[2]; // far
+
+		for (glm::vec4& p : planes) p /= glm::length(glm::vec3(p));
+	}
+
+	// false only if the sphere is entirely outside
+	bool contains(glm::vec3 center, float radius) const {
+		for (const glm::vec4& p : planes) {
+			if (glm::dot(glm::vec3(p), center) + p.w < -radius) return false;
+		}
+		return true;
+	}
+
+	glm::vec4 planes[6];
+};
@@ -0,0 +1,397 @@
+#include "InstancedFlock.h"
+#include <glm/gtc/matrix_inverse.hpp>
+#include <unordered_map>
+
+// boid i is read from 5 texels of the instance buffer: its transform & its animation phase
+// vertex v of animation frame f is read from texels 2 * (f * numVertices + v) (position) & + 1 (normal)
+// a tier's draw covers instances instanceBase + gl_InstanceID
+static const string vertexShader = R"(
+#version 150
+
+uniform mat4 modelViewProjectionMatrix;
+uniform samplerBuffer instances;
+uniform samplerBuffer keyframes;
+uniform int instanceBase;
+uniform int animated; // 0: mesh as is, 1: blend keyframes, 2: nearest keyframe
+uniform int impostor;
+uniform int numVertices;
+uniform int numFrames;
+uniform float animClock;
+uniform float pixelsPerUnit;
+uniform float radius;
+
+in vec4 position;
+in vec3 normal;
+
+out vec3 worldNormal;
+
+// same ping-pong as Simulation3D::animFrame
+float animFrame(float phase) {
+	float last = float(numFrames - 1);
+	if (last <= 0.0) return 0.0;
+
+	float u = mod(animClock + phase * 2.0 * last, 2.0 * last);
+	return u <= last ? u : 2.0 * last - u;
+}
+
+void main() {
+	int k = (instanceBase + gl_InstanceID) * 5;
+	mat4 boid = mat4(texelFetch(instances, k), texelFetch(instances, k + 1),
+		texelFetch(instances, k + 2), texelFetch(instances, k + 3));
+	vec4 anim = texelFetch(instances, k + 4);
+
+	// a point at the boid's center, about half as wide on screen as the fish is long
+	if (impostor != 0) {
+		gl_Position = modelViewProjectionMatrix * boid * vec4(0.0, 0.0, 0.0, 1.0);
+		gl_PointSize = max(1.0, radius * length(boid[0].xyz) * pixelsPerUnit / gl_Position.w);
+		worldNormal = vec3(0.0, 1.0, 0.0);
+		return;
+	}
+
+	vec4 p = position;
+	vec3 n = normal;
+
+	// blend the two animation frames around the boid's frame
+	if (animated != 0) {
+		float frame = animFrame(anim.x);
+		if (animated == 2) frame = floor(frame + 0.5);
+		int a = int(floor(frame));
+		int b = min(a + 1, numFrames - 1);
+		float t = frame - float(a);
+
+		int ka = 2 * (a * numVertices + gl_VertexID);
+		int kb = 2 * (b * numVertices + gl_VertexID);
+		p = vec4(mix(texelFetch(keyframes, ka).xyz, texelFetch(keyframes, kb).xyz, t), 1.0);
+		n = mix(texelFetch(keyframes, ka + 1).xyz, texelFetch(keyframes, kb + 1).xyz, t);
+	}
+
+	worldNormal = mat3(boid) * n;
+	gl_Position = modelViewProjectionMatrix * boid * p;
+}
+)";
+
+static const string fragmentShader = R"(
+#version 150
+
+uniform vec4 diffuse;
+uniform vec4 ambient;
+uniform vec3 lightDir;
+uniform int lit;
+uniform int impostor;
+
+in vec3 worldNormal;
+
+out vec4 fragColor;
+
+void main() {
+	// round sprite, shaded as a ball facing the camera
+	if (impostor != 0) {
+		vec2 c = gl_PointCoord * 2.0 - 1.0;
+		float r2 = dot(c, c);
+		if (r2 > 1.0) discard;
+
+		float d = lit != 0 ? sqrt(1.0 - r2) : 1.0;
+		fragColor = vec4(ambient.rgb * diffuse.rgb * float(lit) + d * diffuse.rgb, diffuse.a);
+		return;
+	}
+
+	if (lit == 0) {
+		fragColor = diffuse;
+		return;
+	}
+
+	// two sided, the model is mirrored by its negative scale
+	float d = abs(dot(normalize(worldNormal), lightDir));
+	fragColor = vec4(ambient.rgb * diffuse.rgb + d * diffuse.rgb, diffuse.a);
+}
+)";
+
+// positions & normals of vertices in every frame, in boid space, side by side in one buffer
+static void buildKeyframes(const vector<FishFrame>& frames, size_t part, const vector<int>& vertices,
+	ofBufferObject& buffer, ofTexture& texture) {
+	vector<glm::vec4> keys;
+	keys.reserve(frames.size() * vertices.size() * 2);
+	for (const FishFrame& frame : frames) {
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(frame.matrix));
+		const ofVboMesh& mesh = frame.parts[part].mesh;
+
+		for (int v : vertices) {
+			keys.push_back(frame.matrix * glm::vec4(mesh.getVertices()[v], 1));
+			keys.push_back(glm::vec4(normalMatrix * mesh.getNormals()[v], 0));
+		}
+	}
+
+	buffer.allocate(keys, GL_STATIC_DRAW);
+	texture.allocateAsBufferTexture(buffer, GL_RGBA32F);
+}
+
+// decimate a triangle mesh by vertex clustering: vertices in one cell of a grid merge into the first of them
+// & triangles left with less than 3 corners are dropped
+// returns the kept vertices, indices gets the triangles as indices into them
+static vector<int> clusterVertices(const vector<glm::vec3>& positions, const vector<ofIndexType>& meshIndices,
+	float cellSize, vector<ofIndexType>& indices) {
+	vector<int> kept;
+	vector<ofIndexType> remap(positions.size());
+	unordered_map<int64_t, ofIndexType> cells;
+
+	for (size_t v = 0; v < positions.size(); v++) {
+		glm::vec3 c = glm::floor(positions[v] / cellSize) + 1024.0f;
+		int64_t key = ((int64_t)c.x << 42) | ((int64_t)c.y << 21) | (int64_t)c.z;
+
+		auto it = cells.find(key);
+		if (it == cells.end()) {
+			it = cells.emplace(key, (ofIndexType)kept.size()).first;
+			kept.push_back(v);
+		}
+		remap[v] = it->second;
+	}
+
+	indices.clear();
+	size_t numCorners = meshIndices.empty() ? positions.size() : meshIndices.size();
+	for (size_t t = 0; t + 2 < numCorners; t += 3) {
+		ofIndexType a = remap[meshIndices.empty() ? t : meshIndices[t]];
+		ofIndexType b = remap[meshIndices.empty() ? t + 1 : meshIndices[t + 1]];
+		ofIndexType c = remap[meshIndices.empty() ? t + 2 : meshIndices[t + 2]];
+		if (a == b || b == c || a == c) continue;
+
+		indices.push_back(a);
+		indices.push_back(b);
+		indices.push_back(c);
+	}
+
+	return kept;
+}
+
+//--------------------------------------------------------------
+bool InstancedFlock::setup(const vector<FishFrame>& frames) {
+	ready = false;
+	if (!ofIsGLProgrammableRenderer()) {
+		cout << "instanced flock needs the programmable renderer, drawing boids one by one" << endl;
+		return false;
+	}
+	if (frames.empty()) return false;
+
+	// keyframes need every frame to have the same meshes & vertex counts
+	for (const FishFrame& frame : frames) {
+		bool same = frame.parts.size() == frames[0].parts.size();
+		for (size_t p = 0; same && p < frame.parts.size(); p++) {
+			same = frame.parts[p].mesh.getNumVertices() == frames[0].parts[p].mesh.getNumVertices() &&
+				frame.parts[p].mesh.getNumNormals() == frame.parts[p].mesh.getNumVertices();
+		}
+		if (!same) {
+			cout << "fish animation frames differ in topology, drawing boids one by one" << endl;
+			return false;
+		}
+	}
+
+	shader.setupShaderFromSource(GL_VERTEX_SHADER, vertexShader);
+	shader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragmentShader);
+	shader.bindDefaults();
+	if (!shader.linkProgram()) {
+		cout << "error linking instanced flock shader" << endl;
+		return false;
+	}
+
+	// first frame in boid space, for the fish's size & the decimation grid
+	numFrames = frames.size();
+	const FishFrame& first = frames[0];
+	vector<vector<glm::vec3>> restPositions(first.parts.size());
+	radius = 0;
+	for (size_t p = 0; p < first.parts.size(); p++) {
+		for (const glm::vec3& v : first.parts[p].mesh.getVertices()) {
+			restPositions[p].push_back(first.matrix * glm::vec4(v, 1));
+			radius = std::max(radius, glm::length(restPositions[p].back()));
+		}
+	}
+	if (radius <= 0) radius = 1;
+
+	// keyframes of every mesh, in full & clustered on a grid about 8 cells across the fish
+	float cellSize = radius / 4;
+	size_t fullVertices = 0, reducedVertices = 0, largest = 0;
+
+	parts.clear();
+	parts.resize(first.parts.size());
+	for (size_t p = 0; p < first.parts.size(); p++) {
+		const FishPart& firstPart = first.parts[p];
+		Part& part = parts[p];
+		part.mesh = &firstPart.mesh;
+		part.diffuse = firstPart.material.getDiffuseColor();
+		part.ambient = firstPart.material.getAmbientColor();
+
+		vector<int> all(firstPart.mesh.getNumVertices());
+		for (size_t v = 0; v < all.size(); v++) all[v] = v;
+		part.full.numVertices = all.size();
+		buildKeyframes(frames, p, all, part.full.buffer, part.full.texture);
+
+		vector<ofIndexType> indices;
+		vector<int> kept = clusterVertices(restPositions[p], firstPart.mesh.getIndices(), cellSize, indices);
+		for (int v : kept) {
+			part.reducedMesh.addVertex(restPositions[p][v]);
+			part.reducedMesh.addNormal(glm::vec3(0, 1, 0));
+		}
+		part.reducedMesh.addIndices(indices);
+		part.reduced.numVertices = kept.size();
+		buildKeyframes(frames, p, kept, part.reduced.buffer, part.reduced.texture);
+
+		fullVertices += all.size();
+		reducedVertices += kept.size();
+		if (all.size() > first.parts[largest].mesh.getNumVertices()) largest = p;
+	}
+
+	impostorDiffuse = parts[largest].diffuse;
+	impostorAmbient = parts[largest].ambient;
+	ofLogVerbose("InstancedFlock") << "fish lod: " << fullVertices << " vertices in full, " << reducedVertices << " reduced";
+
+	point.clear();
+	point.setMode(OF_PRIMITIVE_POINTS);
+	point.addVertex(glm::vec3(0, 0, 0));
+	point.addNormal(glm::vec3(0, 1, 0));
+
+	setHeader(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1));
+
+	ready = true;
+	return true;
+}
+
+//--------------------------------------------------------------
+void InstancedFlock::update(const Flock3D& flock, const ofCamera& camera, float cullRadius) {
+	if (!ready) return;
+
+	// a boid d away is fishPixels / d pixels long on screen
+	glm::vec3 eye = camera.getGlobalPosition();
+	pixelsPerUnit = ofGetViewportHeight() / (2 * tan(glm::radians(camera.getFov()) / 2));
+	float fishPixels = 2 * radius * flock.scale.x * pixelsPerUnit;
+
+	Frustum frustum(camera.getModelViewProjectionMatrix());
+	float sphere = cullRadius * flock.scale.x;
+
+	int count[NumTiers] = {};
+	culled = 0;
+	tiers.resize(flock.size());
+	for (int i = 0; i < flock.size(); i++) {
+		if (cull && !frustum.contains(flock.position[i], sphere)) {
+			tiers[i] = NumTiers;
+			culled++;
+			continue;
+		}
+
+		Tier tier = Full;
+		if (lod) {
+			float d = glm::distance(flock.position[i], eye);
+			float pixels = d > 0 ? fishPixels / d : fishPixels;
+			tier = pixels >= fullPixels ? Full : pixels >= reducedPixels ? Reduced : Impostor;
+		}
+		tiers[i] = tier;
+		count[tier]++;
+	}
+
+	// instances grouped by tier
+	int next[NumTiers];
+	for (int t = 0; t < NumTiers; t++) {
+		next[t] = t == 0 ? 0 : tierEnd[t - 1];
+		tierEnd[t] = next[t] + count[t];
+	}
+
+	instances.resize(flock.size() - culled);
+	for (int i = 0; i < flock.size(); i++) {
+		if (tiers[i] == NumTiers) continue;
+
+		Instance& instance = instances[next[tiers[i]]++];
+		instance.transform = flock.getTransform(i);
+		instance.anim = glm::vec4(flock.animPhase[i], 0, 0, 0);
+	}
+
+	// grow the buffer in steps, the buffer texture has to be reattached after reallocating
+	if (instances.size() > capacity) {
+		capacity = std::max<size_t>(1024, instances.size() * 2);
+		buffer.allocate(capacity * sizeof(Instance), GL_STREAM_DRAW);
+		bufferTexture.allocateAsBufferTexture(buffer, GL_RGBA32F);
+	}
+
+	if (!instances.empty()) {
+		buffer.updateData(0, instances.size() * sizeof(Instance), instances.data());
+	}
+}
+
+//--------------------------------------------------------------
+void InstancedFlock::draw(float animClock, glm::vec3 lightDir) const {
+	drawParts(animClock, OF_MESH_FILL, true, ofFloatColor(), glm::normalize(lightDir));
+}
+
+void InstancedFlock::drawWireframe(float animClock, ofColor color) const {
+	drawParts(animClock, OF_MESH_WIREFRAME, false, color, glm::vec3(0, 1, 0));
+}
+
+// draw every tier: each mesh over its instances at the tier's detail, then the impostors
+void InstancedFlock::drawParts(float animClock, ofPolyRenderMode mode, bool lit, ofFloatColor color, glm::vec3 lightDir) const {
+	if (!ready || instances.empty()) return;
+
+	shader.begin();
+	shader.setUniformTexture("instances", bufferTexture, 0);
+	shader.setUniform1i("impostor", 0);
+	shader.setUniform1i("numFrames", numFrames);
+	shader.setUniform1f("animClock", animClock);
+	shader.setUniform3f("lightDir", lightDir);
+	shader.setUniform1i("lit", lit);
+
+	auto drawTier = [&](Tier tier, const ofVboMesh& mesh, const Keyframes& keys, int animated) {
+		if (tierSize(tier) == 0) return;
+		shader.setUniform1i("instanceBase", tierBegin(tier));
+		shader.setUniform1i("animated", animated);
+		shader.setUniformTexture("keyframes", keys.texture, 1);
+		shader.setUniform1i("numVertices", keys.numVertices);
+		mesh.drawInstanced(mode, tierSize(tier));
+	};
+
+	for (const Part& part : parts) {
+		ofFloatColor diffuse = lit ? part.diffuse : color;
+		shader.setUniform4f("diffuse", diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+		shader.setUniform4f("ambient", part.ambient.r, part.ambient.g, part.ambient.b, part.ambient.a);
+
+		drawTier(Full, *part.mesh, part.full, 1);
+		drawTier(Reduced, part.reducedMesh, part.reduced, 2);
+	}
+
+	if (tierSize(Impostor) > 0) {
+		ofFloatColor diffuse = lit ? impostorDiffuse : color;
+		shader.setUniform4f("diffuse", diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+		shader.setUniform4f("ambient", impostorAmbient.r, impostorAmbient.g, impostorAmbient.b, impostorAmbient.a);
+		shader.setUniform1i("impostor", 1);
+		shader.setUniform1i("instanceBase", tierBegin(Impostor));
+		shader.setUniform1f("pixelsPerUnit", pixelsPerUnit);
+		shader.setUniform1f("radius", radius);
+
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		point.drawInstanced(OF_MESH_FILL, tierSize(Impostor));
+		glDisable(GL_PROGRAM_POINT_SIZE);
+	}
+
+	shader.end();
+}
+
+//--------------------------------------------------------------
+void InstancedFlock::setHeader(glm::vec3 a, glm::vec3 b) {
+	header.clear();
+	header.setMode(OF_PRIMITIVE_LINES);
+	header.addVertex(a);
+	header.addVertex(b);
+	header.addNormal(glm::vec3(0, 1, 0));
+	header.addNormal(glm::vec3(0, 1, 0));
+}
+
+void InstancedFlock::drawHeaders(ofColor color) const {
+	if (!ready || instances.empty()) return;
+
+	ofFloatColor c = color;
+	shader.begin();
+	shader.setUniformTexture("instances", bufferTexture, 0);
+	shader.setUniform1i("instanceBase", 0);
+	shader.setUniform1i("animated", 0);
+	shader.setUniform1i("impostor", 0);
+	shader.setUniform1i("lit", 0);
+	shader.setUniform4f("diffuse", c.r, c.g, c.b, c.a);
+
+	header.drawInstanced(OF_MESH_FILL, instances.size());
+
+	shader.end();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ofMain.h"
+#include "FishModel.h"
+#include "Frustum.h"
+#include "Simulation3D.h"
+
+// draws the whole flock with one instanced draw call per fish mesh & level of detail
+// boid transforms & animation phases are uploaded once a frame into a texture buffer,
+// the animation frames are stored as keyframes of a single mesh & blended in the vertex shader
+// needs the programmable renderer (GL 3.2+), which Mesa's llvmpipe provides
+//
+// boids outside the camera's view are culled before upload
+// with lod on, boids are sorted into tiers by their size on screen:
+//   Full      the fish meshes, animation blended between keyframes
+//   Reduced   decimated meshes, animation stepped to the nearest keyframe
+//   Impostor  one lit point sprite, not animated
+class InstancedFlock {
+public:
+	enum Tier { Full, Reduced, Impostor, NumTiers };
+
+	// keyframes from the animation frames, returns false if instancing is unavailable
+	// or the frames don't share one topology
+	bool setup(const vector<FishFrame>& frames);
+
+	// upload the flock's transforms & phases, once per frame before draw
+	// boids are put in tiers by their size seen from camera, or all drawn in full if lod is off
+	// boids whose bounding sphere of radius (in boid space) is out of the view are left out
+	void update(const Flock3D& flock, const ofCamera& camera, float radius);
+
+	// lod settings, boids this many pixels across or more get the tier
+	bool lod = true;
+	float fullPixels = 40;
+	float reducedPixels = 10;
+
+	bool cull = true;
+
+	// boids in each tier & culled after the last update
+	int tierSize(Tier tier) const { return tierEnd[tier] - tierBegin(tier); }
+	int numCulled() const { return culled; }
+
+	// draw all boids at animation clock animClock (see Simulation3D), lit by a directional light from lightDir
+	void draw(float animClock, glm::vec3 lightDir) const;
+	void drawWireframe(float animClock, ofColor color) const;
+
+	// header line from a to b in boid space, drawn on every boid by drawHeaders
+	void setHeader(glm::vec3 a, glm::vec3 b);
+	void drawHeaders(ofColor color) const;
+
+	bool isReady() const { return ready; }
+
+private:
+	// a mesh with its positions & normals in every animation frame
+	struct Keyframes {
+		ofBufferObject buffer;
+		ofTexture texture;
+		int numVertices;
+	};
+
+	// one fish mesh, in full & decimated
+	struct Part {
+		const ofVboMesh* mesh; // topology, shared by all frames
+		Keyframes full;
+		ofVboMesh reducedMesh;
+		Keyframes reduced;
+		ofFloatColor diffuse, ambient;
+	};
+
+	// per boid, read by the vertex shader as 5 texels
+	struct Instance {
+		glm::mat4 transform;
+		glm::vec4 anim; // x: phase
+	};
+
+	void drawParts(float animClock, ofPolyRenderMode mode, bool lit, ofFloatColor color, glm::vec3 lightDir) const;
+	int tierBegin(Tier tier) const { return tier == Full ? 0 : tierEnd[tier - 1]; }
+
+	bool ready = false;
+	vector<Part> parts;
+	int numFrames = 0;
+	float radius = 1; // of the fish in boid space, sizes the impostors
+	float pixelsPerUnit = 1; // pixels across of a unit at distance 1 from the camera
+	ofFloatColor impostorDiffuse, impostorAmbient; // colors of the largest mesh
+
+	ofShader shader;
+	ofVboMesh header;
+	ofVboMesh point; // impostor
+
+	// sorted by tier, tier t is instances [tierBegin(t), tierEnd[t])
+	vector<Instance> instances;
+	vector<unsigned char> tiers; // NumTiers for culled boids
+	int tierEnd[NumTiers] = {};
+	int culled = 0;
+	ofBufferObject buffer;
+	ofTexture bufferTexture;
+	size_t capacity = 0;
+};
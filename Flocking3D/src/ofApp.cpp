@@ -1,30 +1,6 @@
 #include "ofApp.h"
 
 
-void Boid::turnBoid(glm::vec3 p) {
-	ofApp* theApp = (ofApp*)ofGetAppPtr();
-
-	glm::mat4 rot = rotateToVector(p);
-	glm::vec3 eulerAngles = glm::eulerAngles(glm::quat_cast(rot));
-	float eps = 0.4;
-
-	glm::vec3 crossProduct = glm::cross(heading(), p - position);
-	if (eulerAngles.x < (1.0 - eps)) {
-		angularForce.x = theApp->turnSpeed;
-		angularForce.x *= (crossProduct.x > 0) ? -1 : 1;
-	}
-
-	if (eulerAngles.y < (1.0 - eps)) {
-		angularForce.y = theApp->turnSpeed;
-		angularForce.y *= (crossProduct.y > 0) ? -1 : 1;
-	}
-
-	if (eulerAngles.z < (1.0 - eps)) {
-		angularForce.z = theApp->turnSpeed;
-		angularForce.z *= (crossProduct.z > 0) ? 1 : -1;
-	}
-}
-
 //--------------------------------------------------------------
 void ofApp::setup() {
 	ofSetBackgroundColor(ofColor::lightGray);
@@ -39,17 +15,35 @@ void ofApp::setup() {
 	gui.add(sep.set("Separation", true));
 	gui.add(coh.set("Cohesion", true));
 	gui.add(ali.set("Alignment", true));
+	gui.add(multithreaded.set("Multithreaded Update (M)", false));
+	gui.add(simThreaded.set("Simulation Thread (J)", true));
+	gui.add(simd.set("SIMD Rules (V)", false));
+	gui.add(fixedTimestep.set("Fixed Timestep (X)", false));
+	gui.add(topological.set("Topological kNN (N)", false));
+	gui.add(neighborLists.set("Neighbor Lists (E)", false));
+	gui.add(unbounded.set("Unbounded World (Q)", false));
+	gui.add(instanced.set("Instanced Rendering (I)", true));
+
+	lodSettings.setName("Level of Detail");
+	lodSettings.add(cull.set("Frustum Culling (U)", true));
+	lodSettings.add(lod.set("LOD (K)", true));
+	lodSettings.add(lodFullPixels.set("Full Detail Above (px)", 40, 10, 200));
+	lodSettings.add(lodReducedPixels.set("Reduced Above (px)", 10, 1, 100));
 
 	robotSettings.setName("Robot Boid Settings");
 	robotSettings.add(predatorMode.set("Predator Mode (P)", false));
 	robotSettings.add(leaderMode.set("Leader Mode (L)", false));
 	robotSettings.add(thrust.set("Thrust", 25, 10, 50));
+	robotSettings.add(numPredators.set("Predator Agents", 0, 0, 500));
+	robotSettings.add(numLeaders.set("Leader Agents", 0, 0, 50));
 
 	flockSettings.setName("Flock Settings");
-	flockSettings.add(numBoids.set("# of Boids", 1, 0, 500));
+	flockSettings.add(numBoids.set("# of Boids", 1, 0, 100000));
 	flockSettings.add(scale.set("Boid Scale", 1, 1, 5));
 	flockSettings.add(neighborDist.set("Neighbor Distance", 40, 10, 50));
 	flockSettings.add(separationVal.set("Desired Separation", 10, 1, 100));
+	flockSettings.add(numNearest.set("Nearest Neighbors (k)", 7, 1, 32));
+	flockSettings.add(skin.set("Neighbor List Skin", 2, 0, 10));
 	flockSettings.add(fleeSpeed.set("Flee Speed", 5, 1, 10));
 
 	movement.setName("Flock Movement");
@@ -58,41 +52,27 @@ void ofApp::setup() {
 	movement.add(maxSpeed.set("Max Speed", 4, 1, 5));
 	movement.add(turnSpeed.set("Turn Speed", 50, 0, 100));
 
+	replaySettings.setName("Recording");
+	replaySettings.add(record.set("Record (C)", false));
+	replaySettings.add(replay.set("Replay (O)", false));
+	replaySettings.add(replaySpeed.set("Replay Speed", 1, -8, 8));
+	replaySettings.add(replayPosition.set("Replay Position", 0, 0, 1));
+
+	profiling.setName("Profiling");
+	profiling.add(profileHud.set("Profiler HUD (G)", false));
+	profiling.add(profileCsv.set("Write Profile CSV", false));
+
+	gui.add(lodSettings);
 	gui.add(robotSettings);
 	gui.add(flockSettings);
 	gui.add(movement);
+	gui.add(replaySettings);
+	gui.add(profiling);
 
 
-	// load model
+	// load model in the background, boids show up once it's ready
 	// this specific fish model has 7 animation states (0-6)
-	for (int i = 0; i < 7; ++i) {
-		auto model = make_unique<ofxAssimpModelLoader>();
-		string path = "geo/fish-" + to_string(i);
-
-		if (model->loadModel(path + ".obj")) {
-
-			// correct model position so that it's center is at 0, 0, 0
-			glm::vec3 minBound = model->getSceneMin();
-			glm::vec3 maxBound = model->getSceneMax();
-			glm::vec3 center = (minBound + maxBound) / 2;
-			headerYOffset = center.y / 2;
-
-			// determine max dimension of model
-			if (center.x > modelRadius) modelRadius = center.x;
-			if (center.y > modelRadius) modelRadius = center.y;
-			if (center.z > modelRadius) modelRadius = center.z;
-
-			model->setScaleNormalization(false);
-			model->setScale(0.5, -0.5, -0.5);
-
-			materials.push_back(model->getMaterialForMesh(path + ".mtl"));
-			boidModels.push_back(model.release());
-		}
-		else {
-			cout << "error loading " + path + ".obj" << endl;
-		}
-	}
-	cout << modelRadius << endl;
+	fish.load("geo/fish-", 7, "geo/fish.cache");
 
 	// light setup
 	ofSetSmoothLighting(true);
@@ -103,201 +83,302 @@ void ofApp::setup() {
 	light.setAmbientColor(ofColor(150, 150, 150));
 
 
-	// flock & robotBoid setup
-	createFlock();
-	robotBoid = new RobotBoid(glm::vec3(0, 0, 0)); // default parameters: center, no speed
-	robotBoid->header.y = headerYOffset;
-	robotBoid->modelColor = ofColor::dimGray;
-	robotBoid->headerColor = ofColor::red;
-	robotBoid->animState = 0;
+	// flock & robotBoid setup, carries on from the last checkpoint if there is one
+	syncParams();
+	if (!loadCheckpoint()) {
+		sim.createFlock(numBoids);
+		sim.robotBoid = RobotBoid(glm::vec3(0, 0, 0)); // default parameters: center, no speed
+	}
 
 
 	// camera setup
 	theCam = &freeCam;
 	freeCam.setDistance(10);
 	freeCam.setNearClip(.1);
-	robotCamPos = robotBoid->position + glm::vec3(0, 0, -1);
+	robotCamPos = sim.robotBoid.position + glm::vec3(0, 0, -1);
 	robotCam.setPosition(robotCamPos);
-	rbLookAt = robotBoid->position + robotBoid->heading();
+	rbLookAt = sim.robotBoid.position + sim.robotBoid.heading();
 	robotCam.lookAt(rbLookAt);
 
 
 	// target point
-	targetPoint = glm::vec3(0, 0, 0);
+	sim.targetPoint = glm::vec3(0, 0, 0);
 }
 
-// create new flock
-void ofApp::createFlock() {
-	flock.clear();
-	/*float w = ofGetWindowWidth(); // CHANGE BOUNDS FOR 3D
-	float h = ofGetWindowHeight();
-
-	glm::vec3 minBounds = theCam.screenToWorld(glm::vec3(0, 0, 0));
-	minBounds.z = theCam.getPosition().z + theCam.getNearClip();
-	glm::vec3 maxBounds = theCam.screenToWorld(glm::vec3(w, h, 0));*/
-
-
-	for (int i = 0; i < numBoids; i++) {
-		createBoid();
-	}
+// model sizes & drawing that depend on the fish model
+void ofApp::fishLoaded() {
+	headerYOffset = fish.headerYOffset;
+	modelRadius = fish.modelRadius;
+	cullRadius = fish.boundingRadius;
+	cout << modelRadius << endl;
+	header.y = headerYOffset;
+	float radius = modelRadius;
+	int numAnimStates = fish.frames.size();
+	apply([radius, numAnimStates](Simulation3D& s) {
+		s.modelRadius = radius;
+		s.numAnimStates = numAnimStates;
+	});
+
+	// instanced flock drawing, falls back to drawing boids one by one
+	if (instancedFlock.setup(fish.frames)) {
+		instancedFlock.setHeader(glm::vec3(0, headerYOffset, 0), header);
+	}
+	else instanced = false;
 }
 
-// create random new boid within bounds
-void ofApp::createBoid() {
-	Boid* b = new Boid(glm::vec3(ofRandom(minBounds.x, maxBounds.x),
-		ofRandom(minBounds.y, maxBounds.y), ofRandom(minBounds.z, maxBounds.z)));
-	b->header.y = headerYOffset;
-	b->rotation = glm::vec3(ofRandom(0, 359), ofRandom(0, 359), ofRandom(0, 359));
-	b->scale = glm::vec3(scale, scale, scale);
+// draw the fish at animation phase, in boid space
+// without instancing the frames aren't blended, the nearest one is drawn
+void ofApp::drawFish(float phase, bool wireframe, const ofMaterial* material) {
+	if (fish.frames.empty()) return;
+	int state = std::round(drawn->animFrame(phase));
+	const FishFrame& frame = fish.frames[std::min(state, (int)fish.frames.size() - 1)];
 
-	// randomly select starting animation
-	b->modelColor = ofColor::lightBlue;
-	b->headerColor = ofColor::green;
-	b->animState = (int)ofRandom(0, boidModels.size());
+	ofPushMatrix();
+	ofMultMatrix(frame.matrix);
 
-	// initial speed
-	b->force = b->heading() * ofRandom(minSpeed, maxSpeed);
+	for (const FishPart& part : frame.parts) {
+		if (wireframe) {
+			part.mesh.drawWireframe();
+		}
+		else {
+			const ofMaterial& m = material ? *material : part.material;
+			m.begin();
+			part.mesh.drawFaces();
+			m.end();
+		}
+	}
 
-	flock.push_back(b);
+	ofPopMatrix();
 }
 
-// push boid away from neighbors
-glm::vec3 ofApp::separate(Boid* boid, int index) {
-	glm::vec3 direction = glm::vec3(0, 0, 0);
-	float numNeighbors = 0;
+// robot boid, agents & flock, inside the camera
+// boids whose bounding sphere is out of view are skipped
+void ofApp::drawBoids() {
+	Frustum frustum(theCam->getModelViewProjectionMatrix());
+	float sphere = cullRadius * scale;
+	numCulled = 0;
 
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
+	// draw robot boid & agents
+	drawRobot(drawn->robotBoid, frustum, robotColor);
+	for (const Agent& a : drawn->agents) drawRobot(a.boid, frustum, a.predator ? predatorColor : leaderColor);
 
-		// determine if b is a neighbor
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist < (modelRadius * 2)) && (dist < separationVal)) {
 
-			// find direction from neighbor to boid
-			glm::vec3 diff = glm::normalize(boid->position - b->position);
+	// draw flock, the instanced flock culls as it uploads
+	const Flock3D& flock = drawn->flock;
+	if (instanced && instancedFlock.isReady()) {
+		numCulled += instancedFlock.numCulled();
+		if (toggleHeader) instancedFlock.drawHeaders(headerColor);
 
-			direction += diff / dist;
-			numNeighbors++;
-		}
+		if (bWireFrame) instancedFlock.drawWireframe(drawn->animClock, modelColor);
+		else instancedFlock.draw(drawn->animClock, light.getPosition());
 	}
+	else for (int i = 0; i < flock.size(); i++) {
+		if (cull && !frustum.contains(flock.position[i], sphere)) {
+			numCulled++;
+			continue;
+		}
 
-	glm::vec3 robotForce = glm::vec3(0, 0, 0);
-	if (predatorMode) { // predator mode: flee from robot boid
-
-		float dist = glm::distance(boid->position, robotBoid->position);
+		ofPushMatrix();
+		ofMultMatrix(flock.getTransform(i));
 
-		// check if robot boid is in range AND getting closer
-		if ((dist > 0) && (dist < neighborDist) && (dist < boid->predatorDist)) {
+		if (toggleHeader) { // show boid direction
+			ofSetColor(headerColor);
+			ofDrawLine(glm::vec3(0, headerYOffset, 0), header);
+		}
 
-			// direction away from robot boid
-			glm::vec3 diff = boid->position - robotBoid->position;
-			robotForce = diff * fleeSpeed.get();
+		if (bWireFrame) {
+			ofSetColor(modelColor);
+			drawFish(flock.animPhase[i], true);
+		}
+		else {
+			ofEnableLighting();
+			drawFish(flock.animPhase[i], false);
+			ofDisableLighting();
 		}
 
-		boid->predatorDist = dist;
+		ofPopMatrix();
 	}
-	else if (leaderMode) { // leader mode: boid is following robot boid, maintain regular separation
+}
 
-		float dist = glm::distance(boid->position, robotBoid->position);
-		if ((dist > 0) && (dist < separationVal)) {
+// robot boid or agent in color, unless it's out of view
+void ofApp::drawRobot(const RobotBoid& robot, const Frustum& frustum, ofColor color) {
+	if (cull && !frustum.contains(robot.position, cullRadius * scale)) {
+		numCulled++;
+		return;
+	}
 
-			// find direction from neighbor to robot boid
-			glm::vec3 diff = glm::normalize(boid->position - robotBoid->position);
+	ofPushMatrix();
+	ofMultMatrix(robot.getTransform());
 
-			robotForce = diff / dist;
-			numNeighbors++;
-		}
+	if (toggleHeader) { // show boid direction
+		ofSetColor(robotHeaderColor);
+		ofDrawLine(glm::vec3(0, headerYOffset, 0), header);
 	}
 
-	if (numNeighbors > 0) {
-		// return avg direction away from neighbors
-		direction /= numNeighbors;
-		return direction + robotForce;
+	if (bWireFrame) {
+		ofSetColor(color);
+		drawFish(robot.animPhase, true);
+	}
+	else {
+		robotMaterial.setDiffuseColor(color);
+		ofSetColor(color);
+		drawFish(robot.animPhase, false, &robotMaterial);
 	}
 
-	return robotForce; // no neighbors
+	ofPopMatrix();
 }
 
-// find center of a neighborhood of boids and push them towards it
-glm::vec3 ofApp::cohesion(Boid* boid, int index) {
-	glm::vec3 avgPosition = glm::vec3(0, 0, 0);
-	float numNeighbors = 0;
+// copy gui settings into the simulation
+void ofApp::syncParams() {
+	FlockParams3D& p = params;
+	p.startSim = startSim;
+	p.targetMode = targetMode;
+	p.sep = sep;
+	p.coh = coh;
+	p.ali = ali;
+	p.multithreaded = multithreaded;
+	p.simd = simd;
+	p.fixedTimestep = fixedTimestep;
+	p.topological = topological;
+	p.numNearest = numNearest;
+	p.neighborLists = neighborLists;
+	p.skin = skin;
+	p.unbounded = unbounded;
+
+	p.predatorMode = predatorMode;
+	p.leaderMode = leaderMode;
+	p.numPredators = numPredators;
+	p.numLeaders = numLeaders;
+
+	p.scale = scale;
+	p.neighborDist = neighborDist;
+	p.separationVal = separationVal;
+	p.fleeSpeed = fleeSpeed;
+
+	p.flapFreq = flapFreq;
+	p.minSpeed = minSpeed;
+	p.maxSpeed = maxSpeed;
+	p.turnSpeed = turnSpeed;
+
+	// a posted command allocates, so only post when something changed
+	if (paramsPosted && p == postedParams) return;
+	postedParams = p;
+	paramsPosted = true;
+
+	apply([p](Simulation3D& s) { s.params = p; });
+}
 
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
+// copy the simulation's settings back into the gui, so the next syncParams keeps them
+void ofApp::restoreParams() {
+	const FlockParams3D& p = sim.params;
+	startSim = p.startSim;
+	targetMode = p.targetMode;
+	sep = p.sep;
+	coh = p.coh;
+	ali = p.ali;
+	multithreaded = p.multithreaded;
+	simd = p.simd;
+	fixedTimestep = p.fixedTimestep;
+	topological = p.topological;
+	numNearest = p.numNearest;
+	neighborLists = p.neighborLists;
+	skin = p.skin;
+	unbounded = p.unbounded;
+
+	predatorMode = p.predatorMode;
+	leaderMode = p.leaderMode;
+	numPredators = p.numPredators;
+	numLeaders = p.numLeaders;
+
+	scale = p.scale;
+	neighborDist = p.neighborDist;
+	separationVal = p.separationVal;
+	fleeSpeed = p.fleeSpeed;
+
+	flapFreq = p.flapFreq;
+	minSpeed = p.minSpeed;
+	maxSpeed = p.maxSpeed;
+	turnSpeed = p.turnSpeed;
+	params = p;
+}
 
-		// determine if b is a neighbor & prevent from moving closer if their spaces are overlapping
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist > (modelRadius * 2)) && (dist < neighborDist)) {
-			avgPosition += b->position;
-			numNeighbors++;
-		}
-	}
+// step the simulation on its own thread when the toggle is on, in update() while replaying
+void ofApp::updateSimThread() {
+	bool threaded = simThreaded && !replay;
 
-	// leader (robot boid) has greater say on position of flock
-	glm::vec3 robotForce = glm::vec3(0, 0, 0);
-	if (leaderMode) {
-		float dist = glm::distance(boid->position, robotBoid->position);
-		if ((dist > (modelRadius * 2)) && (dist < neighborDist)) {
-			glm::vec3 diff = robotBoid->position - boid->position;
-			robotForce = diff * fleeSpeed.get();
-		}
+	if (threaded && !simThread.isRunning()) {
+		simThread.start(sim, [this](Simulation3D& s, float dt) {
+			s.update(dt);
+			if (recorder.isOpen()) s.record(recorder); // only opened & closed while the thread is stopped
+		});
 	}
+	else if (!threaded && simThread.isRunning()) simThread.stop();
+}
 
-	if (numNeighbors > 0) {
-		// return direction to avg position
-		avgPosition /= numNeighbors;
-		return (avgPosition - boid->position) + robotForce;
+// run command on the simulation: queued for the sim thread while it runs, right away otherwise
+void ofApp::apply(std::function<void(Simulation3D&)> command) {
+	if (simThread.isRunning()) simThread.post(std::move(command));
+	else command(sim);
+}
+
+// save the simulation & gui settings to the data folder
+void ofApp::saveCheckpoint() {
+	simThread.stop();
+	if (sim.save(ofToDataPath("checkpoint.bin", true)) && gui.saveToFile("checkpoint.xml")) {
+		cout << "saved checkpoint of " << sim.flock.size() << " boids" << endl;
 	}
+}
 
-	return robotForce; // no neighbors
+// restore the last saved checkpoint, false if there's none
+bool ofApp::loadCheckpoint() {
+	simThread.stop();
+	if (!ofFile::doesFileExist("checkpoint.bin") || !sim.load(ofToDataPath("checkpoint.bin", true))) return false;
+
+	// the gui file has the settings that aren't simulation params, the checkpoint has the rest
+	gui.loadFromFile("checkpoint.xml");
+	restoreParams();
+	numBoids = sim.flock.size();
+	record = false;
+	replay = false;
+	return true;
 }
 
-// get difference between boid velocity & average velocity of neighbors
-glm::vec3 ofApp::align(Boid* boid, int index) {
-	glm::vec3 avgHeading = glm::vec3(0, 0, 0);
-	float avgSpeed = 0;
-	float numNeighbors = 0;
-
-	// get velocity of neighboring boids
-	for (int i = 0; i < flock.size(); i++) {
-		if (i == index) continue;
-		Boid* b = flock[i];
-
-		// determine if b is a neighbor
-		float dist = glm::distance(boid->position, b->position);
-		if ((dist > 0) && (dist < neighborDist)) {
-			avgHeading += b->heading();
-			avgSpeed = glm::length(b->velocity);
-			numNeighbors++;
-		}
-	}
+// time frames while the hud or the csv export is on
+void ofApp::updateProfiler() {
+	Profiler& profiler = sim.profiler;
+	profiler.enabled = profileHud || profileCsv;
 
-	// leader (robot boid) has greater say on velocity of flock
-	glm::vec3 robotForce = glm::vec3(0, 0, 0);
-	if (leaderMode) {
-		float dist = glm::distance(boid->position, robotBoid->position);
-		if ((dist > 0) && (dist < neighborDist)) {
-			robotForce = robotBoid->heading() * glm::length(robotBoid->velocity);
-			numNeighbors++;
-		}
+	if (profileCsv && !profiler.isWritingCsv()) {
+		string path = ofToDataPath("profile-" + ofGetTimestampString() + ".csv", true);
+		if (!profiler.openCsv(path)) profileCsv = false;
 	}
+	else if (!profileCsv && profiler.isWritingCsv()) profiler.closeCsv();
+}
 
-	if (numNeighbors > 0) {
-		// get average heading, speed of neighbors
-		avgHeading /= numNeighbors;
-		avgSpeed /= numNeighbors;
+// start/stop recording & replay when their toggles change
+void ofApp::updateRecording() {
+	if (replay) record = false; // replays aren't recorded again
 
-		// cap boid velocity
-		if (abs(glm::length(boid->velocity)) > maxSpeed) avgSpeed = 0;
+	// the recorder is only opened & closed while the sim thread is stopped, it's restarted in updateSimThread()
+	if (record != recorder.isOpen()) simThread.stop();
 
-		// return avg velocity
-		return (avgHeading * avgSpeed) + robotForce;
+	if (record && !recorder.isOpen()) {
+		recordingPath = ofToDataPath("flock-" + ofGetTimestampString() + ".flock", true);
+		if (!recorder.open(recordingPath, 3, Simulation3D::recordedFloats)) record = false;
+	}
+	else if (!record && recorder.isOpen()) {
+		recorder.close();
+		cout << "recorded " << recorder.framesWritten() << " frames to " << recordingPath << endl;
 	}
 
-	return robotForce; // no neighbors
+	if (replay && !recording.isOpen()) {
+		if (!recording.open(recordingPath) || recording.dims() != 3 || recording.numFrames() == 0) {
+			recording.close();
+			replay = false;
+		}
+		replayPosition = 0;
+	}
+	else if (!replay && recording.isOpen()) recording.close();
 }
 
 //--------------------------------------------------------------
@@ -306,121 +387,64 @@ void ofApp::update() {
 	float height = ofGetWindowHeight();
 	glm::vec3 bounds = theCam.screenToWorld(glm::vec3(width, height, 0));*/
 
+	updateRecording();
+	updateSimThread();
+	syncParams();
+	updateProfiler();
 
-	// update robot boid
-	animTime = 5000 / (10 * flapFreq);
-	if (ofGetElapsedTimeMillis() - robotBoid->timer >= animTime) {
-		if (robotBoid->animState == 0) robotBoid->animUpdate = 1;
-		else if (robotBoid->animState == boidModels.size() - 1) {
-			robotBoid->animUpdate = -1;
-		}
+	if (replay) {
+		// show a recorded frame instead of simulating, plays while the simulation is started
+		float last = recording.numFrames() - 1;
+		float frame = replayPosition * last;
+		if (startSim && last > 0) frame = ofWrap(frame + replaySpeed, 0, last);
+		replayPosition = last > 0 ? frame / last : 0;
 
-		robotBoid->animState += robotBoid->animUpdate;
-		robotBoid->timer = ofGetElapsedTimeMillis();
+		sim.replay(recording, std::round(frame));
+		postedBoids = -1; // the recorded flock size is replaced by the slider's after the replay
 	}
-	if (rbIntegrate) {
-		robotBoid->integrate();
-	}
-	else if (glm::length(robotBoid->velocity) == 0 && glm::length(robotBoid->angularVelocity) == 0) {
-		rbIntegrate = false;
-	}
-
-
-	// update robot boid cam
-	robotCamPos = robotBoid->position + glm::vec3(0, 0, 1);
-	robotCam.setPosition(robotCamPos);
-	rbLookAt = robotBoid->position + robotBoid->heading();
-	robotCam.lookAt(rbLookAt);
-
+	else {
+		// update flock size based on numBoids slider
+		int n = numBoids;
+		if (n != postedBoids) {
+			postedBoids = n;
+			apply([n](Simulation3D& s) { s.resize(n); });
+		}
 
-	// update flock size based on numBoids slider
-	if (numBoids < flock.size()) {
+		// update robot boid & all boids in the flock, unless the sim thread does
+		// fixed timestep mode steps by the real time that passed, in constant dt substeps
+		if (!simThread.isRunning()) {
+			if (fixedTimestep) sim.update(ofGetLastFrameTime());
+			else sim.update(1.0 / ofGetFrameRate());
 
-		// decrease flock size
-		int diff = flock.size() - numBoids;
-		for (int i = 0; i < diff; i++) {
-			flock.pop_back();
+			if (record) sim.record(recorder);
 		}
 	}
-	else if (numBoids > flock.size()) {
 
-		// increase flock size
-		int diff = numBoids - flock.size();
-		for (int i = 0; i < diff; i++) {
-			createBoid();
-		}
+	// the sim thread's newest frame, never waits for a step in progress
+	if (simThread.isRunning()) drawn = &simThread.latest();
+	else {
+		sim.snapshot(stepped);
+		drawn = &stepped;
 	}
 
+	// finish loading the fish model
+	if (fish.update()) fishLoaded();
 
-	// update all boids in the flock
-	for (int i = 0; i < flock.size(); i++) {
-
-		Boid* b = flock[i];
-		b->scale = glm::vec3(scale, scale, scale);
-
-
-		// update boid animation by switching to next model
-		animTime = 5000 / (10 * flapFreq);
-		if (ofGetElapsedTimeMillis() - b->timer >= animTime) {
-			if (b->animState == 0) b->animUpdate = 1;
-			else if (b->animState == boidModels.size() - 1) b->animUpdate = -1;
-
-			b->animState += b->animUpdate;
-			b->timer = ofGetElapsedTimeMillis();
-		}
-
-
-		// target mode - test turn & movement
-		if (targetMode) {
-
-			b->turnBoid(targetPoint);
-
-			if (startSim) b->force = targetPoint - b->position;
-			else b->force = glm::vec3(0, 0, 0);
-
-			b->integrate();
-			continue;
-		}
-
-
-		// flocking simulation
-		if (startSim) {
-
-			// determine boid movement based on flock algorithm
-			// separation: keep boid a certain distance from neighbors
-			if (sep) b->force += separate(b, i);
-
-			// cohesion: keep boid a certain distance within neighbors
-			if (coh) b->force += cohesion(b, i);
-
-			// alignment: match boid speed with neighbor's speeds
-			if (ali) b->force += align(b, i);
-
-			// turn boid towards direction its moving
-			b->turnBoid(b->position + b->velocity);
-
-			// integrate
-			b->integrate();
-
-			// cap velocity
-			if (glm::length(b->velocity) > maxSpeed) {
-				b->velocity = glm::normalize(b->velocity) * maxSpeed.get();
-			}
-
-			// wrap around edges of bounds
-			// FOR 3D - MAKE BOUNDS BASED ON CAMERA VIEW?
-			// FAR DISTANCE BOUND BY CAMERA DISTANCE (ZOOM)?
-			// make if position + velocity * dt > bounds, add opposing force? or just wrap around
-			if (b->position.x < minBounds.x) b->position.x += (maxBounds.x - minBounds.x);
-			else if (b->position.x > maxBounds.x) b->position.x -= (maxBounds.x - minBounds.x);
+	// upload boid transforms for the instanced draw, tiered by their size in the current view
+	if (instanced) {
+		instancedFlock.lod = lod;
+		instancedFlock.fullPixels = lodFullPixels;
+		instancedFlock.reducedPixels = lodReducedPixels;
+		instancedFlock.cull = cull;
+		instancedFlock.update(drawn->flock, *theCam, cullRadius);
+	}
 
-			if (b->position.y < minBounds.y) b->position.y += (maxBounds.y - minBounds.y);
-			else if (b->position.y > maxBounds.y) b->position.y -= (maxBounds.y - minBounds.y);
 
-			if (b->position.z < minBounds.z) b->position.z += (maxBounds.z - minBounds.z);
-			else if (b->position.z > maxBounds.z) b->position.z -= (maxBounds.z - minBounds.z);
-		}
-	}
+	// update robot boid cam
+	robotCamPos = drawn->robotBoid.position + glm::vec3(0, 0, 1);
+	robotCam.setPosition(robotCamPos);
+	rbLookAt = drawn->robotBoid.position + drawn->robotBoid.heading();
+	robotCam.lookAt(rbLookAt);
 }
 
 //--------------------------------------------------------------
@@ -441,65 +465,14 @@ void ofApp::draw() {
 	// draw target point
 	if (targetMode) {
 		ofSetColor(ofColor::orange);
-		ofDrawSphere(targetPoint, 0.2);
-	}
-
-
-	// draw robot boid
-	ofPushMatrix();
-	ofMultMatrix(robotBoid->getTransform());
-
-	if (toggleHeader) { // show boid direction
-		ofSetColor(robotBoid->headerColor);
-		ofDrawLine(glm::vec3(0, headerYOffset, 0), robotBoid->header);
-	}
-
-	if (bWireFrame) {
-		ofSetColor(robotBoid->modelColor);
-		boidModels[robotBoid->animState]->drawWireframe();
+		ofDrawSphere(drawn->targetPoint, 0.2);
 	}
-	else {
-		materials[robotBoid->animState].setDiffuseColor(robotBoid->modelColor);
-		materials[robotBoid->animState].begin();
 
-		ofSetColor(robotBoid->modelColor);
-		boidModels[robotBoid->animState]->enableMaterials();
-		boidModels[robotBoid->animState]->enableColors();
-		boidModels[robotBoid->animState]->enableNormals();
-		boidModels[robotBoid->animState]->drawFaces();
 
-		materials[robotBoid->animState].end();
-	}
-
-	ofPopMatrix();
-
-
-	// draw flock
-	for (Boid* b : flock) {
-		ofPushMatrix();
-		ofMultMatrix(b->getTransform());
-
-		if (toggleHeader) { // show boid direction
-			ofSetColor(b->headerColor);
-			ofDrawLine(glm::vec3(0, headerYOffset, 0), b->header);
-		}
-
-		if (bWireFrame) {
-			ofSetColor(b->modelColor);
-			boidModels[b->animState]->drawWireframe();
-		}
-		else {
-			ofEnableLighting();
-
-			boidModels[b->animState]->enableMaterials();
-			boidModels[b->animState]->enableColors();
-			boidModels[b->animState]->enableNormals();
-			boidModels[b->animState]->drawFaces();
-
-			ofDisableLighting();
-		}
-
-		ofPopMatrix();
+	// boids are drawn once the fish model is loaded
+	if (fish.isLoaded()) {
+		ProfileScope scope(sim.profiler, profile::DrawFlock);
+		drawBoids();
 	}
 
 
@@ -509,7 +482,32 @@ void ofApp::draw() {
 
 
 	// draw gui
-	if (!bHide) gui.draw();
+	if (!bHide) {
+		ProfileScope scope(sim.profiler, profile::DrawGui);
+		gui.draw();
+	}
+
+	if (profileHud) drawProfiler();
+	sim.profiler.endFrame();
+}
+
+// phase timings to the right of the gui
+void ofApp::drawProfiler() {
+	glm::vec3 p = gui.getPosition();
+	float x = bHide ? p.x : p.x + gui.getWidth() + 10;
+	string report = sim.profiler.report();
+	report += "simd kernels " + string(kernels::name(sim.simdLevel)) + "\n";
+	report += "culled " + ofToString(numCulled) + " of " + ofToString(drawn->flock.size() + drawn->agents.size() + 1) + " boids\n";
+	if (neighborLists) {
+		report += "lists rebuilt " + ofToString(sim.neighborList.rebuilds.load()) +
+			" of " + ofToString(sim.neighborList.steps.load()) + " steps\n";
+	}
+	if (instanced && lod) {
+		report += "lod full " + ofToString(instancedFlock.tierSize(InstancedFlock::Full)) +
+			" reduced " + ofToString(instancedFlock.tierSize(InstancedFlock::Reduced)) +
+			" impostor " + ofToString(instancedFlock.tierSize(InstancedFlock::Impostor)) + "\n";
+	}
+	ofDrawBitmapStringHighlight(report, x, p.y + 20);
 }
 
 //--------------------------------------------------------------
@@ -532,10 +530,11 @@ void ofApp::keyPressed(int key) {
 
 	// reset all boids
 	if (keymap['r'] || keymap['R']) {
-		createFlock();
-		robotBoid->position = glm::vec3(0, 0, 0);
-		robotBoid->velocity = glm::vec3(0, 0, 0);
-		robotBoid->rotation = glm::vec3(0, 0, 0);
+		int n = numBoids;
+		apply([n](Simulation3D& s) {
+			s.createFlock(n);
+			s.resetRobot();
+		});
 	}
 
 	// enable/disable target mode
@@ -544,6 +543,49 @@ void ofApp::keyPressed(int key) {
 	// enable/disable wireframe on models
 	if (keymap['z'] || keymap['Z']) bWireFrame = !bWireFrame;
 
+	// single or multithreaded flock update
+	if (keymap['m'] || keymap['M']) multithreaded = !multithreaded;
+
+	// simd or scalar neighbor rules
+	if (keymap['v'] || keymap['V']) simd = !simd;
+
+	// simulation on its own thread or in update()
+	if (keymap['j'] || keymap['J']) simThreaded = !simThreaded;
+
+	// fixed or per frame timestep
+	if (keymap['x'] || keymap['X']) fixedTimestep = !fixedTimestep;
+
+	// neighbors within range or the k nearest
+	if (keymap['n'] || keymap['N']) topological = !topological;
+
+	// reuse neighbor searches across steps
+	if (keymap['e'] || keymap['E']) neighborLists = !neighborLists;
+
+	// wrap around the world box or roam freely
+	if (keymap['q'] || keymap['Q']) unbounded = !unbounded;
+
+	// instanced or per boid flock drawing
+	if (keymap['i'] || keymap['I']) instanced = !instanced && instancedFlock.isReady();
+
+	// start/stop recording the flock
+	if (keymap['c'] || keymap['C']) record = !record;
+
+	// replay the last recording instead of simulating
+	if (keymap['o'] || keymap['O']) replay = !replay;
+
+	// save/restore a checkpoint of the whole simulation
+	if (keymap[OF_KEY_F5]) saveCheckpoint();
+	if (keymap[OF_KEY_F9]) loadCheckpoint();
+
+	// skip drawing boids out of view
+	if (keymap['u'] || keymap['U']) cull = !cull;
+
+	// level of detail by screen size, in instanced drawing
+	if (keymap['k'] || keymap['K']) lod = !lod;
+
+	// show/hide frame timings
+	if (keymap['g'] || keymap['G']) profileHud = !profileHud;
+
 	// enable/disable predator mode for robot boid
 	if (keymap['p'] || keymap['P']) {
 		predatorMode = !predatorMode;
@@ -558,29 +600,40 @@ void ofApp::keyPressed(int key) {
 
 
 	// robot boid movement
+	float t = thrust;
 	if (keymap[OF_KEY_UP]) { // move forward
-		robotBoid->force = robotBoid->heading() * thrust.get();
-		rbIntegrate = true;
+		apply([t](Simulation3D& s) {
+			s.robotBoid.force = s.robotBoid.heading() * t;
+			s.rbIntegrate = true;
+		});
 	}
 
 	if (keymap['a'] || keymap['A']) { // turn left about y-axis
-		robotBoid->angularForce = glm::vec3(0, 1, 0) * thrust.get() * 10;
-		rbIntegrate = true;
+		apply([t](Simulation3D& s) {
+			s.robotBoid.angularForce = glm::vec3(0, 1, 0) * t * 10;
+			s.rbIntegrate = true;
+		});
 	}
 
 	if (keymap['d'] || keymap['D']) { // turn right about y-axis
-		robotBoid->angularForce = glm::vec3(0, -1, 0) * thrust.get() * 10;
-		rbIntegrate = true;
+		apply([t](Simulation3D& s) {
+			s.robotBoid.angularForce = glm::vec3(0, -1, 0) * t * 10;
+			s.rbIntegrate = true;
+		});
 	}
 
 	if (keymap['w'] || keymap['W']) { // lift up
-		robotBoid->force = glm::vec3(0, 1, 0) * thrust.get();
-		rbIntegrate = true;
+		apply([t](Simulation3D& s) {
+			s.robotBoid.force = glm::vec3(0, 1, 0) * t;
+			s.rbIntegrate = true;
+		});
 	}
 
 	if (keymap['s'] || keymap['S']) { // drip down
-		robotBoid->force = glm::vec3(0, -1, 0) * thrust.get();
-		rbIntegrate = true;
+		apply([t](Simulation3D& s) {
+			s.robotBoid.force = glm::vec3(0, -1, 0) * t;
+			s.rbIntegrate = true;
+		});
 	}
 }
 
@@ -614,21 +667,10 @@ bool ofApp::getMouseIntersect(glm::vec3 p) {
 void ofApp::mousePressed(int x, int y, int button) {
 	if (keymap[OF_KEY_CONTROL] && getMouseIntersect(glm::vec3(x, y, 0))) {
 
-		if (targetMode) targetPoint = mouseIntersect;
+		glm::vec3 p = mouseIntersect;
+		if (targetMode) apply([p](Simulation3D& s) { s.targetPoint = p; });
 		else {
-			Boid* b = new Boid(mouseIntersect);
-			b->rotation = glm::vec3(ofRandom(0, 359), ofRandom(0, 359), ofRandom(0, 359));
-			b->scale = glm::vec3(scale, scale, scale);
-			b->modelColor = ofColor::lightBlue;
-			b->headerColor = ofColor::green;
-
-			// randomly select starting animation
-			b->animState = (int)ofRandom(0, boidModels.size());
-
-			// initial speed
-			b->force = b->heading() * ofRandom(minSpeed, maxSpeed);
-
-			flock.push_back(b);
+			apply([p](Simulation3D& s) { s.addBoid(p); });
 			numBoids++;
 		}
 	}
@@ -645,4 +687,10 @@ void ofApp::windowResized(int w, int h) {}
 //--------------------------------------------------------------
 void ofApp::gotMessage(ofMessage msg) {}
 //--------------------------------------------------------------
-void ofApp::dragEvent(ofDragInfo dragInfo) {}
+void ofApp::dragEvent(ofDragInfo dragInfo) {
+	// replay a recording dropped on the window
+	if (dragInfo.files.empty()) return;
+	recordingPath = dragInfo.files[0];
+	recording.close();
+	replay = true;
+}